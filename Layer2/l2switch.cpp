@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 
 void nodeSetInterfaceL2Mode(Node *node, const std::string &interface_name, const InterfaceNetworkProperty::L2Mode &mode)
@@ -33,65 +34,149 @@ void nodeSetInterfaceVLANMembership(Node *node, const std::string &interface_nam
 
 MACTableEntry::MACTableEntry() :
     mac_addr(),
-    oif_name("")
+    vlan_id(0),
+    oif(nullptr),
+    last_seen(0),
+    aging_tick(0)
 {
 
 }
 
-MACTableEntry *MACTable::MACTableLookup(const MACAddress &mac_addr)
+MACTable::MACTable() :
+    entries(INITIAL_CAPACITY),
+    aging_time(DEFAULT_AGING_TIME),
+    now(getCurrentTick()),
+    aging_wheel(now),
+    version(0),
+    published_version(0),
+    published_time_ns(0),
+    snapshot()
 {
-    auto result = std::find_if(
-        std::begin(mac_table),
-        std::end(mac_table),
-        [&](const MACTableEntry &mac_table_entry)
-        {
-            return mac_table_entry.mac_addr == mac_addr;
-        }
-    );
+    // readers see an empty table until the first change is published
+    snapshot.publish(new Snapshot());
+}
 
-    if (result == std::end(mac_table)) {
-        return nullptr;
-    }
-    return &(*result);
+uint32_t MACTable::getCurrentTick()
+{
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
 }
 
-void MACTable::deleteEntry(const MACAddress &mac_addr)
+uint64_t MACTable::getMonotonicTimeNs()
 {
-    mac_table.remove_if(
-        [&](const MACTableEntry &mac_table_entry)
-        {
-            return mac_table_entry.mac_addr == mac_addr;
-        });
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-bool MACTable::addEntry(MACTableEntry *mac_table_entry)
+MACTableEntry *MACTable::MACTableLookup(const MACAddress &mac_addr, uint32_t vlan_id)
+{
+    return entries.find(makeKey(mac_addr, vlan_id));
+}
+
+void MACTable::deleteEntry(const MACAddress &mac_addr, uint32_t vlan_id)
 {
-    MACTableEntry *mac_table_entry_old = MACTableLookup(mac_table_entry->mac_addr);
-    // no need to add!
-    if (mac_table_entry_old && memcmp(mac_table_entry_old, mac_table_entry, sizeof(MACTableEntry)) == 0) {
-        // caller need to free MACTableEntry
-        return false;
+    // the aging timer of the entry is left armed, it finds the entry gone when it fires
+    if (entries.erase(makeKey(mac_addr, vlan_id))) {
+        version++;
     }
+}
+
+bool MACTable::addEntry(MACTableEntry *mac_table_entry)
+{
+    uint64_t key = makeKey(mac_table_entry->mac_addr, mac_table_entry->vlan_id);
+    auto [entry, is_added] = entries.insert(key);
 
-    if (mac_table_entry_old) {
-        deleteEntry(mac_table_entry_old->mac_addr);
+    if (!is_added) {
+        entry->last_seen = now;
+        // no need to update!
+        if (entry->oif == mac_table_entry->oif) {
+            return false;
+        }
+        // station moved. its aging timer stays armed.
+        entry->oif = mac_table_entry->oif;
+        version++;
+        return true;
     }
 
-    mac_table.push_back(*mac_table_entry);
+    *entry = *mac_table_entry;
+    entry->last_seen = now;
+    entry->aging_tick = now + aging_time;
+    aging_wheel.schedule(key, entry->aging_tick);
+    version++;
 
     return true;
 }
 
-void MACTable::dump() const
+void MACTable::age()
+{
+    now = getCurrentTick();
+    aging_wheel.advance(now, [this](uint64_t key, uint64_t expiry_tick) {
+        MACTableEntry *entry = entries.find(key);
+        if (!entry || entry->aging_tick != expiry_tick) {
+            // the entry has been deleted, or relearned with a new timer
+            return;
+        }
+
+        uint32_t expiry = entry->last_seen + aging_time;
+        if (expiry > now) {
+            // refreshed since the timer was armed
+            entry->aging_tick = expiry;
+            aging_wheel.schedule(key, expiry);
+            return;
+        }
+        entries.erase(key);
+        version++;
+    });
+
+    publishSnapshot();
+}
+
+void MACTable::publishSnapshot()
 {
-    for (const auto &mac_table_entry : mac_table) {
-        std::cout <<
-            "MAC : " <<
-            static_cast<std::string>(mac_table_entry.mac_addr) <<
-            " | Intf : " <<
-            mac_table_entry.oif_name <<
-            std::endl;
+    if (version == published_version) {
+        return;
     }
+
+    Snapshot *new_snapshot = new Snapshot();
+    new_snapshot->version = version;
+    new_snapshot->entries.reserve(entries.size());
+    entries.forEach([new_snapshot](uint64_t key, const MACTableEntry &entry) {
+        (void)key;
+        new_snapshot->entries.push_back(entry);
+    });
+    snapshot.publish(new_snapshot);
+    published_version = version;
+    published_time_ns = getMonotonicTimeNs();
+}
+
+void MACTable::publishSnapshotIfDue()
+{
+    if (version == published_version) {
+        return;
+    }
+    // small tables are cheap to copy. large ones are throttled, so that learning storms do not copy them per event.
+    if (entries.size() > MAX_UNTHROTTLED_ENTRIES && getMonotonicTimeNs() - published_time_ns < MIN_PUBLISH_INTERVAL_NS) {
+        return;
+    }
+    publishSnapshot();
+}
+
+void MACTable::dump() const
+{
+    readSnapshot([](const Snapshot *snapshot) {
+        if (!snapshot) {
+            return;
+        }
+        for (const auto &entry : snapshot->entries) {
+            std::cout <<
+                "MAC : " <<
+                static_cast<std::string>(entry.mac_addr) <<
+                " | Intf : " <<
+                entry.oif->getName() <<
+                " | VLAN : " <<
+                entry.vlan_id <<
+                std::endl;
+        }
+    });
 }
 
 MACTable *getNewMACTable()
@@ -106,23 +191,20 @@ void deleteMACTable(MACTable *mac_table)
 
 extern void dumpPacket(EthernetHeader *ethernet_header, uint32_t packet_size);
 
-void l2SwitchSendPacketOut(Node *node, Interface *intf, char *packet, uint32_t packet_size)
+void l2SwitchSendPacketOut(Node *node, Interface *intf, PacketBuffer *packet)
 {
     if (intf->isL3Mode()) {
         std::cout << "Error : tried to forward L2 Switch frame on L3 mode interface." << std::endl;
         assert(false);
     }
 
-    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet);
+    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet->getData());
     uint32_t vlan_id = 0;
     if (VLAN8021QHeader *p = isPacketVLANTagged(ethernet_header); p) {
         vlan_id = p->getVLANID();
     }
 
-    char *packet_tmp = new char[packet_size];
-    char *packet_tmp_header = packet_tmp;
-    memcpy(packet_tmp, packet, packet_size);
-
+    // the frame is shared with other egress ports and is never modified here.
     switch (intf->getL2Mode()) {
     case InterfaceNetworkProperty::L2Mode::ACCESS:
     {
@@ -133,12 +215,8 @@ void l2SwitchSendPacketOut(Node *node, Interface *intf, char *packet, uint32_t p
         if (vlan_id != intf->getVLANID()) {
             break;
         }
-        if (vlan_id) {
-            uint32_t new_packet_size = 0;
-            packet_tmp = reinterpret_cast<char *>(untagPacketWithVLANID(reinterpret_cast<EthernetHeader *>(packet_tmp), packet_size, &new_packet_size));
-            packet_size = new_packet_size;
-        }
-        intf->sendPacketOut(packet_tmp, packet_size);
+        // the tag is left out on the wire, so the shared frame needs no private copy
+        intf->sendPacketOut(packet, true);
         break;
     }
     case InterfaceNetworkProperty::L2Mode::TRUNK:
@@ -146,7 +224,7 @@ void l2SwitchSendPacketOut(Node *node, Interface *intf, char *packet, uint32_t p
         if (!intf->isVLANMember(vlan_id)) {
             break;
         }
-        intf->sendPacketOut(packet_tmp, packet_size);
+        intf->sendPacketOut(packet);
         break;
     }
     default:
@@ -154,47 +232,56 @@ void l2SwitchSendPacketOut(Node *node, Interface *intf, char *packet, uint32_t p
         break;
     }
     }
-
-    delete[] packet_tmp_header;
 }
 
-static void l2SwitchForwardFrame(Node *node, Interface *recv_intf, char *packet, uint32_t packet_size)
+static void l2SwitchForwardFrame(Node *node, Interface *recv_intf, PacketBuffer *packet, uint32_t vlan_id)
 {
-    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet);
-    if (ethernet_header->dst_mac == MACAddress::BROADCAST_MAC_ADDRESS) {
-        node->sendPacketFloodToL2Interface(recv_intf, packet, packet_size);
+    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet->getData());
+    StormControl &storm_control = recv_intf->getStormControl();
+
+    // group addresses are never learned, so they are flooded without a lookup
+    if (ethernet_header->dst_mac.isMulticast()) {
+        StormControl::TrafficType type = ethernet_header->dst_mac == MACAddress::BROADCAST_MAC_ADDRESS ?
+            StormControl::TrafficType::BROADCAST : StormControl::TrafficType::MULTICAST;
+        if (storm_control.admit(type)) {
+            node->sendPacketFloodToL2Interface(recv_intf, packet, vlan_id);
+        }
         return;
     }
 
     MACTable *mac_table = const_cast<MACTable *>(node->getMACTable());
-    MACTableEntry *mac_table_entry = mac_table->MACTableLookup(ethernet_header->dst_mac);
+    MACTableEntry *mac_table_entry = mac_table->MACTableLookup(ethernet_header->dst_mac, vlan_id);
 
     if (!mac_table_entry) {
-        node->sendPacketFloodToL2Interface(recv_intf, packet, packet_size);
+        if (storm_control.admit(StormControl::TrafficType::UNKNOWN_UNICAST)) {
+            node->sendPacketFloodToL2Interface(recv_intf, packet, vlan_id);
+        }
         return;
     }
 
-    Interface *oif = node->getNodeInterfaceByName(mac_table_entry->oif_name);
-    if (!oif) {
-        return;
-    }
-    l2SwitchSendPacketOut(node, oif, packet, packet_size);
+    l2SwitchSendPacketOut(node, mac_table_entry->oif, packet);
 }
 
-static void l2SwitchPerformMACLearning(Node *node, const MACAddress &src_mac, const std::string &if_name)
+static void l2SwitchPerformMACLearning(Node *node, const MACAddress &src_mac, uint32_t vlan_id, Interface *intf)
 {
     MACTable *mac_table = const_cast<MACTable *>(node->getMACTable());
     MACTableEntry entry;
     entry.mac_addr = src_mac;
-    entry.oif_name = if_name;
+    entry.vlan_id = vlan_id;
+    entry.oif = intf;
     mac_table->addEntry(&entry);
 }
 
-void l2SwitchRecvFrame(Interface *intf, char *packet, uint32_t packet_size)
+void l2SwitchRecvFrame(Interface *intf, PacketBuffer *packet, uint32_t vlan_id)
 {
     Node *node = const_cast<Node *>(intf->getNode());
-    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet);
+    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet->getData());
 
-    l2SwitchPerformMACLearning(node, ethernet_header->src_mac, intf->getName());
-    l2SwitchForwardFrame(node, intf, packet, packet_size);
+    l2SwitchPerformMACLearning(node, ethernet_header->src_mac, vlan_id, intf);
+    l2SwitchForwardFrame(node, intf, packet, vlan_id);
+}
+
+void l2SwitchAgeMACTable(Node *node)
+{
+    const_cast<MACTable *>(node->getMACTable())->age();
 }
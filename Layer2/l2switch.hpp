@@ -6,11 +6,17 @@
  * @date 2022-05-05
  */
 
-#include <list>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #include "../graph.hpp"
 #include "../net.hpp"
+#include "../open_addressing_table.hpp"
+#include "../packet_buffer.hpp"
 #include "../printer.hpp"
+#include "../rcu_snapshot.hpp"
+#include "../timer_wheel.hpp"
 
  /* L2 Switching functionallity */
 void nodeSetInterfaceL2Mode(Node *node, const std::string &interface_name, const InterfaceNetworkProperty::L2Mode &mode);
@@ -19,34 +25,179 @@ struct MACTableEntry {
     MACTableEntry();
 
     MACAddress mac_addr;
-    std::string oif_name;
+    uint16_t vlan_id;
+    Interface *oif; /* interfaces live as long as their node, the name is looked up only for dump */
+    uint32_t last_seen;   /* aging tick on which the station was last learned */
+    uint32_t aging_tick;  /* expiry of the aging timer armed for the entry */
 };
 
+/**
+ * @class MACTable
+ * @brief forwarding table of a switch.
+ *        Entries are stored inline in an OpenAddressingTable keyed by the MAC address and the VLAN ID,
+ *        so each VLAN learns its stations independently (IVL), and learning and lookup take constant time
+ *        regardless of the number of stations.
+ *        Entries not learned again within the aging time are removed by `age`. Relearning a known station
+ *        only refreshes its timestamp : the aging timer notices the refresh when it fires and re-arms itself.
+ *        The table is modified only by the receiver thread of its node. Other threads read the snapshot
+ *        published by the receiver thread at the end of the receive event which changed the table.
+ *        Tables larger than MAX_UNTHROTTLED_ENTRIES are copied at most once per MIN_PUBLISH_INTERVAL_NS,
+ *        changes in between are published by a later receive event or by the next aging tick.
+ */
 class MACTable : public IPrinter {
 public:
-    MACTable() {}
+    static constexpr uint32_t INITIAL_CAPACITY = 64;
+    static constexpr uint32_t DEFAULT_AGING_TIME = 300;
+    static constexpr uint32_t MAX_UNTHROTTLED_ENTRIES = 256;
+    static constexpr uint64_t MIN_PUBLISH_INTERVAL_NS = 10000000;
+
+    /**
+     * @struct Snapshot
+     * @brief copy of the entries at a version of the table
+     */
+    struct Snapshot {
+        uint64_t version;
+        std::vector<MACTableEntry> entries;
+    };
+
+    MACTable();
 
     static MACTable *getNewTable()
     {
         return new MACTable();
     }
 
+    /**
+     * @brief adds the entry, or updates the entry of the same MAC address and VLAN ID.
+     *        the entry is stamped with the current aging tick.
+     *
+     * @param mac_table_entry entry to be copied into the table
+     * @return true if the table has been changed
+     * @return false if the same entry already exists, in which case only its timestamp is refreshed
+     */
     bool addEntry(MACTableEntry *mac_table_entry);
-    MACTableEntry *MACTableLookup(const MACAddress &mac_addr);
-    void deleteEntry(const MACAddress &mac_addr);
 
+    /**
+     * @brief finds the entry of `mac_addr` in `vlan_id`.
+     *
+     * @param mac_addr MAC address
+     * @param vlan_id VLAN ID. 0 for untagged stations.
+     * @return MACTableEntry* entry stored in the table, valid until the table is modified. nullptr if not found.
+     */
+    MACTableEntry *MACTableLookup(const MACAddress &mac_addr, uint32_t vlan_id);
+
+    void deleteEntry(const MACAddress &mac_addr, uint32_t vlan_id);
+
+    uint32_t getEntryCount() const
+    {
+        return entries.size();
+    }
+
+    /**
+     * @brief sets the time after which stations not seen are removed.
+     *        armed timers pick up the new value when they fire.
+     *
+     * @param aging_time aging time in seconds
+     */
+    void setAgingTime(uint32_t aging_time)
+    {
+        this->aging_time = std::max(aging_time, 1u);
+    }
+
+    uint32_t getAgingTime() const
+    {
+        return aging_time;
+    }
+
+    /**
+     * @brief catches up with the clock and removes the stations whose aging time has elapsed,
+     *        then publishes a snapshot if the table has changed.
+     *        expected to be called periodically by the thread learning into the table.
+     *
+     */
+    void age();
+
+    /**
+     * @brief publishes a snapshot if the table has changed. a table larger than MAX_UNTHROTTLED_ENTRIES is
+     *        left as is while its last snapshot is younger than MIN_PUBLISH_INTERVAL_NS.
+     *        called by the thread learning into the table at the end of each receive event.
+     *
+     */
+    void publishSnapshotIfDue();
+
+    /**
+     * @brief calls `reader` with the latest snapshot without blocking the thread modifying the table.
+     *
+     * @param reader callback taking `const Snapshot *`, nullptr until the first snapshot is published
+     */
+    template <typename Reader>
+    void readSnapshot(Reader &&reader) const
+    {
+        snapshot.read(std::forward<Reader>(reader));
+    }
+
+    /**
+     * @brief outputs the latest snapshot on the standard output. safe to call from any thread.
+     *
+     */
     virtual void dump() const override;
 
 private:
-    std::list<MACTableEntry> mac_table;
+    // VLAN IDs are 12 bits long, so no (MAC address, VLAN ID) pair maps to this key
+    static constexpr uint64_t EMPTY_KEY = ~0ull;
+
+    static uint64_t makeKey(const MACAddress &mac_addr, uint32_t vlan_id)
+    {
+        return (static_cast<uint64_t>(vlan_id) << 48) | mac_addr.getBitRepresentation();
+    }
+
+    void publishSnapshot();
+
+    /**
+     * @brief returns the current aging tick, which is the monotonic clock in seconds.
+     *
+     * @return uint32_t
+     */
+    static uint32_t getCurrentTick();
+
+    static uint64_t getMonotonicTimeNs();
+
+    OpenAddressingTable<uint64_t, MACTableEntry, EMPTY_KEY> entries;
+
+    uint32_t aging_time;
+    // aging tick as of the last `age` call. learning stamps entries with it instead of reading the clock per frame.
+    uint32_t now;
+    TimerWheel aging_wheel;
+
+    // bumped whenever an entry is added, moved or removed
+    uint64_t version;
+    uint64_t published_version;
+    uint64_t published_time_ns; /* monotonic clock */
+    RCUSnapshot<Snapshot> snapshot;
 };
 
 MACTable *getNewMACTable();
 void deleteMACTable(MACTable *mac_table);
 
 /* L2 Switching APIs */
-void l2SwitchRecvFrame(Interface *intf, char *packet, uint32_t packet_size);
-void l2SwitchSendPacketOut(Node *node, Interface *intf, char *packet, uint32_t packet_size);
+/**
+ * @brief learns the source station of a frame and forwards the frame within its VLAN.
+ *
+ * @param intf receiving interface
+ * @param packet tagged frame
+ * @param vlan_id VLAN the frame has been qualified into
+ */
+void l2SwitchRecvFrame(Interface *intf, PacketBuffer *packet, uint32_t vlan_id);
+/**
+ * @brief sends the frame out of `intf` if the interface belongs to the VLAN of the frame.
+ *        trunk ports send the frame as is, access ports leave its tag out on the wire.
+ *
+ * @param node switch node
+ * @param intf egress interface
+ * @param packet frame. it is never modified, so it can be shared across egress ports.
+ */
+void l2SwitchSendPacketOut(Node *node, Interface *intf, PacketBuffer *packet);
+void l2SwitchAgeMACTable(Node *node);
 
 /* VLAN APIs */
 void nodeSetInterfaceVLANMembership(Node *node, const std::string &interface_name, uint32_t vlan_id);
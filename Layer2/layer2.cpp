@@ -9,115 +9,205 @@
 #include "../comm.hpp"
 #include "../color.hpp"
 #include "../tcpconst.hpp"
+#include "l2switch.hpp"
 #include "layer2.hpp"
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 
- /* extern function prototype declaration */
-
-extern void l2SwitchRecvFrame(Interface *interface, char *packet, uint32_t packet_size);
-
 /* function prototype declaration */
+static uint64_t getMonotonicTimeNs();
 static void processARPReplyMessage(Node *node, Interface *iif, EthernetHeader *ethernet_header);
 static void processARPBroadcastRequest(Node *node, Interface *iif, EthernetHeader *ethernet_header);
 
-void layer2FrameRecv(Node *node, Interface *interface, char *packet, uint32_t packet_size)
+/**
+ * @brief configuration of a receiving interface which an ingress handler is specialized for.
+ *
+ */
+enum class IngressMode {
+    L3_HOST,
+    L2_ACCESS,
+    L2_TRUNK,
+};
+
+static void processL3HostFrame(Node *node, Interface *interface, EthernetHeader *ethernet_header)
+{
+    switch (ethernet_header->type) {
+    case ARP_MSG:
+    {
+        ARPHeader *arp_hdr = reinterpret_cast<ARPHeader *>(ethernet_header->payload);
+        switch (arp_hdr->op_code) {
+        case ARP_BROAD_REQ:
+            processARPBroadcastRequest(node, interface, ethernet_header);
+            break;
+        case ARP_REPLY:
+            processARPReplyMessage(node, interface, ethernet_header);
+            break;
+        default:
+            break;
+        }
+    }
+    break;
+
+    case IP_MSG:
+        std::cout << __FUNCTION__ << " : IP packet recvd on interface " << interface->getName() << " of node " << node->getName() << std::endl;
+        break;
+
+    default:
+        // promotePacketToLayer3(node, interface, packet, packet_size);
+        break;
+    }
+}
+
+template <IngressMode Mode>
+static void layer2FrameRecvOn(Node *node, Interface *interface, PacketBuffer *packet)
 {
     /* Entry point into TCP/IP from bottom */
-    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet);
+    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet->getData());
+
+    uint32_t vlan_id = 0;
+    bool accepted;
+    if constexpr (Mode == IngressMode::L3_HOST) {
+        accepted = l2FrameRecvQualifyOnInterfaceL3Mode(interface, ethernet_header, &vlan_id);
+    }
+    else if constexpr (Mode == IngressMode::L2_ACCESS) {
+        accepted = l2FrameRecvQualifyOnInterfaceAccessMode(interface, ethernet_header, &vlan_id);
+    }
+    else {
+        accepted = l2FrameRecvQualifyOnInterfaceTrunkMode(interface, ethernet_header, &vlan_id);
+    }
 
-    uint32_t vlan_id_to_tag = 0;
-    if (!l2FrameRecvQualifyOnInterface(interface, ethernet_header, &vlan_id_to_tag)) {
+    if (!accepted) {
         std::cout << "L2 Frame Rejected" << std::endl;
         return;
     }
 
     std::cout << "L2 Frame Accepted" << std::endl;
 
-    if (interface->isL3Mode()) {
-        switch (ethernet_header->type) {
-        case ARP_MSG:
-        {
-            ARPHeader *arp_hdr = reinterpret_cast<ARPHeader *>(ethernet_header->payload);
-            switch (arp_hdr->op_code) {
-            case ARP_BROAD_REQ:
-                processARPBroadcastRequest(node, interface, ethernet_header);
-                break;
-            case ARP_REPLY:
-                processARPReplyMessage(node, interface, ethernet_header);
-                break;
-            default:
-                break;
+    if constexpr (Mode == IngressMode::L3_HOST) {
+        processL3HostFrame(node, interface, ethernet_header);
+    }
+    else {
+        // frames arrive untagged on access ports
+        if constexpr (Mode == IngressMode::L2_ACCESS) {
+            if (!tagPacketWithVLANID(packet, vlan_id)) {
+                return;
             }
         }
-        break;
+        l2SwitchRecvFrame(interface, packet, vlan_id);
+    }
+}
 
-        default:
-            // promotePacketToLayer3(node, interface, packet, packet_size);
-            break;
-        }
+static void layer2FrameReject(Node *node, Interface *interface, PacketBuffer *packet)
+{
+    (void)node;
+    (void)interface;
+    (void)packet;
+    std::cout << "L2 Frame Rejected" << std::endl;
+}
+
+IngressHandler layer2ResolveIngressHandler(const Interface *interface)
+{
+    if (interface->isL3Mode()) {
+        return &layer2FrameRecvOn<IngressMode::L3_HOST>;
     }
-    else if (interface->getL2Mode() == InterfaceNetworkProperty::L2Mode::ACCESS ||
-             interface->getL2Mode() == InterfaceNetworkProperty::L2Mode::TRUNK) {
-        if (vlan_id_to_tag) {
-            uint32_t new_packet_size = 0;
-            packet = reinterpret_cast<char *>(tagPacketWithVLANID(reinterpret_cast<EthernetHeader *>(packet), packet_size, vlan_id_to_tag, &new_packet_size));
-            packet_size = new_packet_size;
+
+    switch (interface->getL2Mode()) {
+    case InterfaceNetworkProperty::L2Mode::ACCESS:
+    {
+        // interface must have a VLAN ID when operating on ACCESS mode.
+        if (!interface->getVLANID()) {
+            return &layer2FrameReject;
         }
-        l2SwitchRecvFrame(interface, packet, packet_size);
+        return &layer2FrameRecvOn<IngressMode::L2_ACCESS>;
+    }
+    case InterfaceNetworkProperty::L2Mode::TRUNK:
+    {
+        return &layer2FrameRecvOn<IngressMode::L2_TRUNK>;
+    }
+    default:
+    {
+        return &layer2FrameReject;
+    }
     }
 }
 
+void layer2FrameRecv(Node *node, Interface *interface, PacketBuffer *packet)
+{
+    layer2ResolveIngressHandler(interface)(node, interface, packet);
+}
+
+static uint64_t getMonotonicTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 ARPEntry::ARPEntry() :
     ip_addr(0),
     mac_addr(),
-    oif_name("")
+    oif(nullptr),
+    is_incomplete(false)
 {
 
 }
 
-ARPEntry *ARPTable::arpTableLookup(const std::string &ip_addr)
+ARPTable::ARPTable() :
+    entries(INITIAL_CAPACITY),
+    retry_tick(0),
+    pending_drop_count(0),
+    version(0),
+    published_version(0),
+    published_time_ns(0)
 {
-    auto result = std::find_if(
-        std::begin(arp_table),
-        std::end(arp_table),
-        [&](const ARPEntry &arp_entry)
-        {
-            return arp_entry.ip_addr == IPAddress(ip_addr);
-        }
-    );
+    // readers see an empty table until the first change is published
+    snapshot.publish(new Snapshot{ version, {} });
+}
 
-    if (result == std::end(arp_table)) {
-        return nullptr;
+ARPTable::~ARPTable()
+{
+    for (auto &[key, resolution] : pending_resolutions) {
+        for (auto &packet : resolution.packets) {
+            packet->release();
+        }
     }
-    return &(*result);
 }
 
-void ARPTable::deleteEntry(const std::string &ip_addr)
+ARPEntry *ARPTable::arpTableLookup(const IPAddress &ip_addr)
 {
-    arp_table.remove_if(
-        [&](const ARPEntry &arp_entry)
-        {
-            return arp_entry.ip_addr == IPAddress(ip_addr);
-        });
+    return entries.find(static_cast<uint32_t>(ip_addr));
+}
+
+void ARPTable::deleteEntry(const IPAddress &ip_addr)
+{
+    uint32_t key = static_cast<uint32_t>(ip_addr);
+    ARPEntry *entry = entries.find(key);
+    if (!entry) {
+        return;
+    }
+    if (entry->is_incomplete) {
+        dropPendingResolution(key);
+    }
+    entries.erase(key);
+    version++;
 }
 
 bool ARPTable::addEntry(ARPEntry *arp_entry)
 {
-    ARPEntry *arp_entry_old = arpTableLookup(arp_entry->ip_addr);
-    // no need to add!
-    if (arp_entry_old && memcmp(arp_entry_old, arp_entry, sizeof(ARPEntry)) == 0) {
-        // caller need to free ARPEntry
+    uint32_t key = static_cast<uint32_t>(arp_entry->ip_addr);
+    if (key == EMPTY_KEY) {
         return false;
     }
+    auto [entry, is_added] = entries.insert(key);
 
-    if (arp_entry_old) {
-        deleteEntry(arp_entry_old->ip_addr);
+    // no need to update!
+    if (!is_added && entry->mac_addr == arp_entry->mac_addr && entry->oif == arp_entry->oif &&
+        entry->is_incomplete == arp_entry->is_incomplete) {
+        return false;
     }
-
-    arp_table.push_back(*arp_entry);
+    *entry = *arp_entry;
+    version++;
 
     return true;
 }
@@ -129,23 +219,171 @@ void ARPTable::updateFromARPReply(ARPHeader *arp_header, Interface *iif)
     ARPEntry arp_entry;
     arp_entry.ip_addr = IPAddress(arp_header->src_ip);
     arp_entry.mac_addr = arp_header->src_mac;
-    arp_entry.oif_name = iif->getName();
+    arp_entry.oif = iif;
 
     addEntry(&arp_entry);
+
+    auto it = pending_resolutions.find(static_cast<uint32_t>(arp_entry.ip_addr));
+    if (it == std::end(pending_resolutions)) {
+        return;
+    }
+    // taken out first, as sending may re-enter the table on the direct transport
+    PendingResolution resolution = std::move(it->second);
+    pending_resolutions.erase(it);
+
+    // the receiver thread sends the whole queue within one egress batch
+    for (auto &packet : resolution.packets) {
+        if (packet->isShared()) {
+            // the caller still references the frame, so the address is filled in a private copy
+            PacketBuffer *shared_packet = packet;
+            packet = shared_packet->clone();
+            shared_packet->release();
+        }
+        EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet->getData());
+        ethernet_header->dst_mac = arp_entry.mac_addr;
+        resolution.oif->sendPacketOut(packet);
+        packet->release();
+    }
 }
 
-void ARPTable::dump() const
+ARPTable::PendingResolutionMap::iterator ARPTable::addPendingResolution(const IPAddress &ip_addr, Interface *oif)
 {
-    for (const auto &arp_entry : arp_table) {
-        std::cout <<
-            "IP : " <<
-            getColoredString(arp_entry.ip_addr, "Light Red") <<
-            ", MAC : " <<
-            static_cast<std::string>(arp_entry.mac_addr) <<
-            ", OIF = " <<
-            arp_entry.oif_name <<
-            std::endl;
+    ARPEntry arp_entry;
+    arp_entry.ip_addr = ip_addr;
+    arp_entry.oif = oif;
+    arp_entry.is_incomplete = true;
+    if (!addEntry(&arp_entry)) {
+        return std::end(pending_resolutions);
     }
+    return pending_resolutions.emplace(static_cast<uint32_t>(ip_addr), PendingResolution{ oif, {}, 0, 1, retry_tick + 1 }).first;
+}
+
+bool ARPTable::queuePendingPacket(const IPAddress &ip_addr, Interface *oif, PacketBuffer *packet)
+{
+    // the first packet to an address starts its resolution, later ones are coalesced into it
+    auto it = pending_resolutions.find(static_cast<uint32_t>(ip_addr));
+    bool is_new_resolution = it == std::end(pending_resolutions);
+    if (is_new_resolution) {
+        it = addPendingResolution(ip_addr, oif);
+        if (it == std::end(pending_resolutions)) {
+            pending_drop_count++;
+            return false;
+        }
+    }
+
+    PendingResolution &resolution = it->second;
+    if (resolution.packets.size() >= MAX_PENDING_PACKETS) {
+        pending_drop_count++;
+        return false;
+    }
+    packet->retain();
+    resolution.packets.push_back(packet);
+
+    if (is_new_resolution) {
+        // queued beforehand, since the reply completes the entry within this call on the direct transport
+        sendARPBroadcastRequest(const_cast<Node *>(oif->getNode()), oif, ip_addr);
+    }
+    return true;
+}
+
+bool ARPTable::resolve(const IPAddress &ip_addr, Interface *oif)
+{
+    if (arpTableLookup(ip_addr)) {
+        // resolved, or coalesced into the resolution in progress
+        return true;
+    }
+    if (addPendingResolution(ip_addr, oif) == std::end(pending_resolutions)) {
+        return false;
+    }
+    sendARPBroadcastRequest(const_cast<Node *>(oif->getNode()), oif, ip_addr);
+    return true;
+}
+
+void ARPTable::retryPendingResolutions()
+{
+    retry_tick++;
+
+    // requests are sent after the walk, as replies may modify the table within the call on the direct transport
+    std::vector<std::pair<uint32_t, Interface *>> retried_resolutions;
+    std::vector<uint32_t> abandoned_keys;
+    for (auto &[key, resolution] : pending_resolutions) {
+        if (resolution.next_retry_tick > retry_tick) {
+            continue;
+        }
+        if (resolution.retry_count == MAX_RESOLUTION_RETRIES) {
+            abandoned_keys.push_back(key);
+            continue;
+        }
+        resolution.retry_count++;
+        resolution.retry_interval *= 2;
+        resolution.next_retry_tick = retry_tick + resolution.retry_interval;
+        retried_resolutions.emplace_back(key, resolution.oif);
+    }
+
+    for (auto &key : abandoned_keys) {
+        deleteEntry(IPAddress(key));
+    }
+    for (auto &[key, oif] : retried_resolutions) {
+        sendARPBroadcastRequest(const_cast<Node *>(oif->getNode()), oif, IPAddress(key));
+    }
+}
+
+void ARPTable::dropPendingResolution(uint32_t key)
+{
+    auto it = pending_resolutions.find(key);
+    if (it == std::end(pending_resolutions)) {
+        return;
+    }
+    for (auto &packet : it->second.packets) {
+        packet->release();
+    }
+    pending_drop_count += it->second.packets.size();
+    pending_resolutions.erase(it);
+}
+
+void ARPTable::publishSnapshot()
+{
+    if (version == published_version) {
+        return;
+    }
+    Snapshot *new_snapshot = new Snapshot{ version, {} };
+    new_snapshot->entries.reserve(entries.size());
+    entries.forEach([new_snapshot](uint32_t key, const ARPEntry &entry) {
+        (void)key;
+        new_snapshot->entries.push_back(entry);
+    });
+    snapshot.publish(new_snapshot);
+    published_version = version;
+    published_time_ns = getMonotonicTimeNs();
+}
+
+void ARPTable::publishSnapshotIfDue()
+{
+    if (version == published_version) {
+        return;
+    }
+    // small tables are cheap to copy. large ones are throttled, so that learning storms do not copy them per event.
+    if (entries.size() > MAX_UNTHROTTLED_ENTRIES && getMonotonicTimeNs() - published_time_ns < MIN_PUBLISH_INTERVAL_NS) {
+        return;
+    }
+    publishSnapshot();
+}
+
+void ARPTable::dump() const
+{
+    readSnapshot([](const Snapshot *snapshot) {
+        for (const auto &arp_entry : snapshot->entries) {
+            std::cout <<
+                "IP : " <<
+                getColoredString(arp_entry.ip_addr, "Light Red") <<
+                ", MAC : " <<
+                (arp_entry.is_incomplete ? std::string("INCOMPLETE") : static_cast<std::string>(arp_entry.mac_addr)) <<
+                ", OIF = " <<
+                arp_entry.oif->getName() <<
+                std::endl;
+        }
+    });
+    std::cout << "Pending resolution drops : " << getPendingDropCount() << std::endl;
 }
 
 ARPTable *getNewARPTable()
@@ -158,16 +396,25 @@ void deleteARPTable(ARPTable *arp_table)
     delete arp_table;
 }
 
-static void sendARPReplyMessage(EthernetHeader *ethernet_header_in, Interface *oif)
+void layer2RunPeriodicTasks(Node *node)
 {
-    ARPHeader *arp_header_in = (ARPHeader *)ethernet_header_in->payload;
-    EthernetHeader *ethenet_header_reply = (EthernetHeader *)(new char[MAX_PACKET_BUFFER_SIZE]);
+    l2SwitchAgeMACTable(node);
+    ARPTable *arp_table = const_cast<ARPTable *>(node->getARPTable());
+    arp_table->retryPendingResolutions();
+    arp_table->publishSnapshot();
+}
 
-    ethenet_header_reply->dst_mac = ethernet_header_in->src_mac;
-    ethenet_header_reply->src_mac = oif->getMACAddress();
+void layer2PublishSnapshots(Node *node)
+{
+    const_cast<MACTable *>(node->getMACTable())->publishSnapshotIfDue();
+    const_cast<ARPTable *>(node->getARPTable())->publishSnapshotIfDue();
+}
 
-    ethenet_header_reply->type = ARP_MSG;
-    ARPHeader *arp_header_reply = (ARPHeader *)ethenet_header_reply->payload;
+static void sendARPReplyMessage(EthernetHeader *ethernet_header_in, Interface *oif)
+{
+    ARPHeader *arp_header_in = (ARPHeader *)ethernet_header_in->payload;
+    PacketBuffer *packet = PacketBuffer::allocate();
+    ARPHeader *arp_header_reply = (ARPHeader *)packet->appendTrailer(sizeof(ARPHeader));
 
     arp_header_reply->hw_type = 1;
     arp_header_reply->proto_type = 0x0800;
@@ -182,12 +429,14 @@ static void sendARPReplyMessage(EthernetHeader *ethernet_header_in, Interface *o
     arp_header_reply->dst_mac = arp_header_in->src_mac;
     arp_header_reply->dst_ip = arp_header_in->src_ip;
 
-    ETH_FCS(ethenet_header_reply, sizeof(ARPHeader)) = 0;
+    EthernetHeader *ethenet_header_reply = ALLOC_ETH_HEADER_WITH_PAYLOAD(packet);
 
-    uint32_t total_packet_size = ETH_HDR_SIZE_EXCL_PAYLOAD + sizeof(ARPHeader);
-    char *shifted_packet_buffer = packetBufferShiftRight(reinterpret_cast<char *>(ethenet_header_reply), total_packet_size, MAX_PACKET_BUFFER_SIZE);
-    oif->sendPacketOut(shifted_packet_buffer, total_packet_size);
-    delete[] ethenet_header_reply;
+    ethenet_header_reply->dst_mac = ethernet_header_in->src_mac;
+    ethenet_header_reply->src_mac = oif->getMACAddress();
+    ethenet_header_reply->type = ARP_MSG;
+
+    oif->sendPacketOut(packet);
+    packet->release();
 }
 
 static void processARPReplyMessage(Node *node, Interface *iif, EthernetHeader *ethernet_header)
@@ -198,26 +447,55 @@ static void processARPReplyMessage(Node *node, Interface *iif, EthernetHeader *e
     arp_table->updateFromARPReply((ARPHeader *)ethernet_header->payload, iif);
 }
 
+void layer2ResolveARP(Node *node, const IPAddress &ip_addr)
+{
+    Interface *oif = node->getMatchingSubnetInterface(ip_addr);
+    if (!oif) {
+        std::cout << "Error : " << node->getName() << " : No eligible subnet for ARP resolution for IP address : " << static_cast<std::string>(ip_addr) << std::endl;
+        return;
+    }
+
+    ARPTable *arp_table = const_cast<ARPTable *>(node->getARPTable());
+    arp_table->resolve(ip_addr, oif);
+}
+
+void layer2SendPing(Node *node, const IPAddress &ip_addr)
+{
+    Interface *oif = node->getMatchingSubnetInterface(ip_addr);
+    if (!oif) {
+        std::cout << "Error : " << node->getName() << " : No eligible subnet for IP address : " << static_cast<std::string>(ip_addr) << std::endl;
+        return;
+    }
+
+    // no IP header is modeled yet, so the payload only carries the destination address
+    PacketBuffer *packet = PacketBuffer::allocate();
+    uint32_t *payload = reinterpret_cast<uint32_t *>(packet->appendTrailer(sizeof(uint32_t)));
+    *payload = static_cast<uint32_t>(ip_addr);
+
+    sendPacketToNextHop(node, oif, ip_addr, packet, IP_MSG);
+    packet->release();
+}
+
 void sendARPBroadcastRequest(Node *node, Interface *oif, const std::string &ip_addr)
 {
-    EthernetHeader *ethenet_header = (EthernetHeader *)(new char[MAX_PACKET_BUFFER_SIZE]);
+    sendARPBroadcastRequest(node, oif, IPAddress(ip_addr));
+}
 
+void sendARPBroadcastRequest(Node *node, Interface *oif, const IPAddress &ip_addr)
+{
     if (!oif) {
-        oif = node->getMatchingSubnetInterface(IPAddress(ip_addr));
+        oif = node->getMatchingSubnetInterface(ip_addr);
     }
 
     if (!oif) {
-        std::cout << "Error : " << node->getName() << " : No eligible subnet for ARP resolution for IP address : " << ip_addr << std::endl;
+        std::cout << "Error : " << node->getName() << " : No eligible subnet for ARP resolution for IP address : " << static_cast<std::string>(ip_addr) << std::endl;
         return;
     }
 
-    /* STEP 1 : prepare ethernet header */
-    ethenet_header->dst_mac = MACAddress::BROADCAST_MAC_ADDRESS;
-    ethenet_header->src_mac = oif->getMACAddress();
-    ethenet_header->type = ARP_MSG;
+    PacketBuffer *packet = PacketBuffer::allocate();
 
-    /* STEP2 : prepare ARP Broadcast Request Msg out of oif */
-    ARPHeader *arp_header = (ARPHeader *)ethenet_header->payload;
+    /* STEP 1 : prepare ARP Broadcast Request Msg out of oif */
+    ARPHeader *arp_header = (ARPHeader *)packet->appendTrailer(sizeof(ARPHeader));
     arp_header->hw_type = 1;
     arp_header->proto_type = 0x0800;
     arp_header->hw_addr_len = sizeof(MACAddress);
@@ -229,18 +507,19 @@ void sendARPBroadcastRequest(Node *node, Interface *oif, const std::string &ip_a
     arp_header->src_ip = oif->getIPAddress();
 
     arp_header->dst_mac = MACAddress();
-    arp_header->dst_ip = IPAddress(ip_addr);
+    arp_header->dst_ip = ip_addr;
 
-    /* DO NOT use ethernet_header->FCS = 0, because FCS lies at the
-       end of payload, and not at the end of ethernet header!! */
-    ETH_FCS(ethenet_header, sizeof(ARPHeader)) = 0; // unused
+    /* STEP 2 : encapsulate it in an ethernet frame. the header is pushed in front of the ARP message,
+       and the FCS (unused) is appended behind it */
+    EthernetHeader *ethenet_header = ALLOC_ETH_HEADER_WITH_PAYLOAD(packet);
+    ethenet_header->dst_mac = MACAddress::BROADCAST_MAC_ADDRESS;
+    ethenet_header->src_mac = oif->getMACAddress();
+    ethenet_header->type = ARP_MSG;
 
     /* STEP 3 : Now dispatch the ARP Broadcast Request Packet out of interface */
-    uint32_t total_packet_size = ETH_HDR_SIZE_EXCL_PAYLOAD + sizeof(ARPHeader);
-    char *shifted_packet_buffer = packetBufferShiftRight(reinterpret_cast<char *>(ethenet_header), total_packet_size, MAX_PACKET_BUFFER_SIZE);
-    oif->sendPacketOut(reinterpret_cast<char *>(shifted_packet_buffer), total_packet_size);
+    oif->sendPacketOut(packet);
 
-    delete[] ethenet_header;
+    packet->release();
 }
 
 static void processARPBroadcastRequest(Node *node, Interface *iif, EthernetHeader *ethernet_header)
@@ -262,43 +541,64 @@ static void processARPBroadcastRequest(Node *node, Interface *iif, EthernetHeade
     sendARPReplyMessage(ethernet_header, iif);
 }
 
+void sendPacketToNextHop(Node *node, Interface *oif, const IPAddress &next_hop_ip, PacketBuffer *packet, uint16_t type)
+{
+    EthernetHeader *ethernet_header = ALLOC_ETH_HEADER_WITH_PAYLOAD(packet);
+    if (!ethernet_header) {
+        std::cout << "Error : " << node->getName() << " : no room for the ethernet header of the packet" << std::endl;
+        return;
+    }
+    ethernet_header->src_mac = oif->getMACAddress();
+    ethernet_header->type = type;
+
+    ARPTable *arp_table = const_cast<ARPTable *>(node->getARPTable());
+    ARPEntry *arp_entry = arp_table->arpTableLookup(next_hop_ip);
+    if (arp_entry && !arp_entry->is_incomplete) {
+        ethernet_header->dst_mac = arp_entry->mac_addr;
+        oif->sendPacketOut(packet);
+        return;
+    }
+
+    arp_table->queuePendingPacket(next_hop_ip, oif, packet);
+}
+
 /* VLAN APIs */
-VLANEthernetHeader *tagPacketWithVLANID(EthernetHeader *ethernet_header, uint32_t total_packet_size, int32_t vlan_id, uint32_t *new_packet_size)
+VLANEthernetHeader *tagPacketWithVLANID(PacketBuffer *packet, int32_t vlan_id)
 {
+    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet->getData());
     if (VLAN8021QHeader *p = isPacketVLANTagged(ethernet_header); p) {
         VLANEthernetHeader *vlan_ethernet_header = reinterpret_cast<VLANEthernetHeader *>(ethernet_header);
         vlan_ethernet_header->vlan_8021q_header.tci_vid = vlan_id;
-        *new_packet_size = total_packet_size;
         return vlan_ethernet_header;
     }
-    char *head_position = reinterpret_cast<char *>(ethernet_header) - sizeof(VLAN8021QHeader);
-    char *iterator = head_position;
-    // dst_mac
-    memmove(iterator, &ethernet_header->dst_mac, sizeof(MACAddress));
-    iterator += sizeof(MACAddress);
-    // src_mac
-    memmove(iterator, &ethernet_header->src_mac, sizeof(MACAddress));
-    iterator += sizeof(MACAddress);
-    VLAN8021QHeader *vlan_8021q_header = reinterpret_cast<VLAN8021QHeader *>(iterator);
+
+    // only the MAC addresses move in front of the tag, the payload stays in place
+    char *head_position = packet->pushHeader(sizeof(VLAN8021QHeader));
+    if (!head_position) {
+        return nullptr;
+    }
+    memmove(head_position, ethernet_header, 2 * sizeof(MACAddress));
+
+    VLANEthernetHeader *vlan_ethernet_header = reinterpret_cast<VLANEthernetHeader *>(head_position);
+    VLAN8021QHeader *vlan_8021q_header = &vlan_ethernet_header->vlan_8021q_header;
     vlan_8021q_header->tpid = 0x8100;
     vlan_8021q_header->tci_dei = 0;
     vlan_8021q_header->tci_pcp = 0;
     vlan_8021q_header->tci_vid = vlan_id;
-    *new_packet_size = total_packet_size + sizeof(VLAN8021QHeader);
-    return reinterpret_cast<VLANEthernetHeader *>(head_position);
+    return vlan_ethernet_header;
 }
 
-EthernetHeader *untagPacketWithVLANID(EthernetHeader *ethernet_header, uint32_t total_packet_size, uint32_t *new_packet_size)
+EthernetHeader *untagPacketWithVLANID(PacketBuffer *packet)
 {
+    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(packet->getData());
     if (VLAN8021QHeader *p = isPacketVLANTagged(ethernet_header); !p) {
-        *new_packet_size = total_packet_size;
         return ethernet_header;
     }
-    EthernetHeader *new_ethernet_header = reinterpret_cast<EthernetHeader *>(reinterpret_cast<char *>(ethernet_header) + sizeof(VLAN8021QHeader));
+
     MACAddress dst_mac = ethernet_header->dst_mac;
     MACAddress src_mac = ethernet_header->src_mac;
+    EthernetHeader *new_ethernet_header = reinterpret_cast<EthernetHeader *>(packet->pullHeader(sizeof(VLAN8021QHeader)));
     new_ethernet_header->dst_mac = dst_mac;
     new_ethernet_header->src_mac = src_mac;
-    *new_packet_size = total_packet_size - sizeof(VLAN8021QHeader);
     return new_ethernet_header;
 }
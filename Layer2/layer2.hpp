@@ -8,14 +8,20 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <cstring>
-#include <list>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "../comm.hpp"
 #include "../graph.hpp"
 #include "../net.hpp"
+#include "../open_addressing_table.hpp"
+#include "../packet_buffer.hpp"
 #include "../printer.hpp"
+#include "../rcu_snapshot.hpp"
 
 #pragma pack(push,1)
 
@@ -35,32 +41,32 @@ struct EthernetHeader {
     MACAddress dst_mac;
     MACAddress src_mac;
     uint16_t type;
-    uint8_t payload[248]; /* Max allowed : 1500 */
-    uint32_t FCS;
+    uint8_t payload[]; /* up to the MTU of the interface, followed by the 4-byte FCS */
 };
 #pragma pack(pop)
 
-#define ETH_HDR_SIZE_EXCL_PAYLOAD       (sizeof(EthernetHeader) - sizeof(EthernetHeader::payload))
+#define ETH_FCS_SIZE                    sizeof(uint32_t)
+#define ETH_HDR_SIZE_EXCL_PAYLOAD       (sizeof(EthernetHeader) + ETH_FCS_SIZE)
 #define ETH_FCS(eth_hdr_ptr, payload_size) ( *(uint32_t *)((char *)((EthernetHeader *)eth_hdr_ptr)->payload + payload_size) )
 
-static inline EthernetHeader *ALLOC_ETH_HEADER_WITH_PAYLOAD(char *packet, uint32_t packet_size)
+/**
+ * @brief encapsulates the payload held by `packet` in an ethernet frame. the header is pushed into the headroom
+ *        and the FCS is appended into the tailroom, so the payload is not moved.
+ *        addresses and type of the header are cleared.
+ *
+ * @param packet buffer holding the payload
+ * @return EthernetHeader*. nullptr if the buffer has no room for the header or the FCS.
+ */
+static inline EthernetHeader *ALLOC_ETH_HEADER_WITH_PAYLOAD(PacketBuffer *packet)
 {
-    char *head_position = packet - ETH_HDR_SIZE_EXCL_PAYLOAD;
-    char *iterator = head_position;
-    // dst_mac
-    memset(iterator, 0, sizeof(MACAddress));
-    iterator += sizeof(MACAddress);
-    // src_mac
-    memset(iterator, 0, sizeof(MACAddress));
-    iterator += sizeof(MACAddress);
-    // type
-    memset(iterator, 0, sizeof(uint16_t));
-    iterator += sizeof(uint16_t);
-    // payload
-    memmove(iterator, packet, packet_size);
-    iterator += packet_size;
+    if (packet->getHeadroom() < sizeof(EthernetHeader) || packet->getTailroom() < ETH_FCS_SIZE) {
+        return nullptr;
+    }
     // FCS
-    memset(iterator, 0, sizeof(uint32_t));
+    memset(packet->appendTrailer(ETH_FCS_SIZE), 0, ETH_FCS_SIZE);
+    // dst_mac, src_mac and type
+    char *head_position = packet->pushHeader(sizeof(EthernetHeader));
+    memset(head_position, 0, sizeof(EthernetHeader));
 
     return (EthernetHeader *)head_position;
 }
@@ -83,12 +89,16 @@ struct VLANEthernetHeader {
     MACAddress src_mac;
     VLAN8021QHeader vlan_8021q_header;
     uint16_t type;
-    uint8_t payload[248];
-    uint32_t FCS;
+    uint8_t payload[]; /* up to the MTU of the interface, followed by the 4-byte FCS */
 };
 #pragma pack(pop)
 
-#define VLAN_ETH_HDR_SIZE_EXCL_PAYLOAD       (sizeof(VLANEthernetHeader) - sizeof(VLANEthernetHeader::payload))
+#define VLAN_ETH_HDR_SIZE_EXCL_PAYLOAD       (sizeof(VLANEthernetHeader) + ETH_FCS_SIZE)
+
+static_assert(LinkHeader::MAX_SIZE + VLAN_ETH_HDR_SIZE_EXCL_PAYLOAD + MAX_MTU <= MAX_PACKET_BUFFER_SIZE,
+              "packet buffers must hold a frame of the largest MTU");
+static_assert(LinkHeader::MAX_SIZE + VLAN_ETH_HDR_SIZE_EXCL_PAYLOAD + DEFAULT_MTU <= STANDARD_PACKET_BUFFER_SIZE,
+              "standard packet buffers must hold a frame of the default MTU");
 #define VLAN_ETH_FCS(vlan_eth_hdr_ptr, payload_size) ( *(uint32_t *)((char *)((VLANEthernetHeader *)vlan_eth_hdr_ptr)->payload + payload_size) )
 
 static inline VLAN8021QHeader *isPacketVLANTagged(EthernetHeader *ethernet_header)
@@ -107,15 +117,11 @@ static inline uint8_t *getEthernetHeaderPayload(EthernetHeader *ethernet_header)
     return ethernet_header->payload;
 }
 
-#define GET_COMMON_ETH_FCS(eth_hdr_ptr, payload_size)( *(uint32_t *)((char *)(getEthernetHeaderPayload(eth_hdr_ptr) + payload_size) )
+#define GET_COMMON_ETH_FCS(eth_hdr_ptr, payload_size)( *(uint32_t *)((char *)getEthernetHeaderPayload(eth_hdr_ptr) + payload_size) )
 
 static inline void setCommonEthernetFCS(EthernetHeader *ethernet_header, uint32_t payload_size, uint32_t new_fcs)
 {
-    if (VLAN8021QHeader *p = isPacketVLANTagged(ethernet_header); p) {
-        reinterpret_cast<VLANEthernetHeader *>(ethernet_header)->FCS = new_fcs;
-        return;
-    }
-    ethernet_header->FCS = new_fcs;
+    GET_COMMON_ETH_FCS(ethernet_header, payload_size) = new_fcs;
 }
 
 static inline uint32_t getEthernetHeaderSizeExcludingPayload(EthernetHeader *ethernet_header)
@@ -126,8 +132,8 @@ static inline uint32_t getEthernetHeaderSizeExcludingPayload(EthernetHeader *eth
     return ETH_HDR_SIZE_EXCL_PAYLOAD;
 }
 
-VLANEthernetHeader *tagPacketWithVLANID(EthernetHeader *ethernet_header, uint32_t total_packet_size, int32_t vlan_id, uint32_t *new_packet_size);
-EthernetHeader *untagPacketWithVLANID(EthernetHeader *ethernet_header, uint32_t total_packet_size, uint32_t *new_packet_size);
+VLANEthernetHeader *tagPacketWithVLANID(PacketBuffer *packet, int32_t vlan_id);
+EthernetHeader *untagPacketWithVLANID(PacketBuffer *packet);
 
 static inline bool l2FrameRecvQualifyOnInterfaceAccessMode(Interface *intf, EthernetHeader *ethernet_header, uint32_t *output_vlan_id)
 {
@@ -149,40 +155,18 @@ static inline bool l2FrameRecvQualifyOnInterfaceAccessMode(Interface *intf, Ethe
 
 static inline bool l2FrameRecvQualifyOnInterfaceTrunkMode(Interface *intf, EthernetHeader *ethernet_header, uint32_t *output_vlan_id)
 {
-    // output_vlan_id is not used on trunk mode
-    (void)output_vlan_id;
-
     if (VLAN8021QHeader *p = isPacketVLANTagged(ethernet_header); !p) {
         return false;
     }
     VLANEthernetHeader *vlan_ethernet_header = reinterpret_cast<VLANEthernetHeader *>(ethernet_header);
-
-    return intf->isVLANMember(vlan_ethernet_header->vlan_8021q_header.getVLANID());
-}
-
-static inline bool l2FrameRecvQualifyOnInterfaceL2Mode(Interface *intf, EthernetHeader *ethernet_header, uint32_t *output_vlan_id)
-{
-    bool will_accept = false;
-    switch (intf->getL2Mode()) {
-    case InterfaceNetworkProperty::L2Mode::ACCESS:
-    {
-        will_accept = l2FrameRecvQualifyOnInterfaceAccessMode(intf, ethernet_header, output_vlan_id);
-        break;
-    }
-    case InterfaceNetworkProperty::L2Mode::TRUNK:
-    {
-        will_accept = l2FrameRecvQualifyOnInterfaceTrunkMode(intf, ethernet_header, output_vlan_id);
-        break;
-    }
-    case InterfaceNetworkProperty::L2Mode::L2_MODE_UNKOWN:
-    {
-        // drop the packet
-        will_accept = false;
-        break;
-    }
+    uint32_t vlan_id = vlan_ethernet_header->vlan_8021q_header.getVLANID();
+    if (!intf->isVLANMember(vlan_id)) {
+        return false;
     }
 
-    return will_accept;
+    // tagged packet has arrived. the packet stays in the VLAN of its tag.
+    *output_vlan_id = vlan_id;
+    return true;
 }
 
 static inline bool l2FrameRecvQualifyOnInterfaceL3Mode(Interface *intf, EthernetHeader *ethernet_header, uint32_t *output_vlan_id)
@@ -207,15 +191,24 @@ static inline bool l2FrameRecvQualifyOnInterfaceL3Mode(Interface *intf, Ethernet
     return false;
 }
 
-static inline bool l2FrameRecvQualifyOnInterface(Interface *intf, EthernetHeader *ethernet_hdr, uint32_t *output_vlan_id)
-{
-    if (intf->isL3Mode()) {
-        return l2FrameRecvQualifyOnInterfaceL3Mode(intf, ethernet_hdr, output_vlan_id);
-    }
-    return l2FrameRecvQualifyOnInterfaceL2Mode(intf, ethernet_hdr, output_vlan_id);
-}
+/**
+ * @brief processes a frame received on `interface`, looking up the handler for its current configuration.
+ *        the receive path calls the handler cached by the interface instead.
+ *
+ * @param node node owning the interface
+ * @param interface receiving interface
+ * @param packet frame recvd. the caller keeps its reference, the frame may be modified in place.
+ */
+void layer2FrameRecv(Node *node, Interface *interface, PacketBuffer *packet);
 
-void layer2FrameRecv(Node *node, Interface *interface, char *packet, uint32_t packet_size);
+/**
+ * @brief selects the ingress handler specialized for the L3 host, L2 access or L2 trunk configuration of `interface`.
+ *        interfaces which can accept no frame get a handler rejecting everything.
+ *
+ * @param interface interface
+ * @return IngressHandler
+ */
+IngressHandler layer2ResolveIngressHandler(const Interface *interface);
 
 /* ARP Table APIs */
 struct ARPEntry {
@@ -224,29 +217,279 @@ struct ARPEntry {
 
     IPAddress ip_addr;
     MACAddress mac_addr;
-    std::string oif_name;
+    Interface *oif; /* interfaces live as long as their node, the name is looked up only for dump */
+    bool is_incomplete; /* resolution in progress, mac_addr is not known yet */
 };
 
+/**
+ * @class ARPTable
+ * @brief IP to MAC address bindings of a node.
+ *        Entries are stored inline in an OpenAddressingTable keyed by the 32-bit IP address,
+ *        so resolving an address takes constant time and neither parses nor allocates.
+ *        Packets sent to an unresolved address wait on an incomplete entry while a single ARP request
+ *        is retried with exponential backoff. They are sent as soon as the reply completes the entry,
+ *        or dropped when the resolution gives up.
+ *        The table is modified only by the receiver thread of its node. Other threads read the snapshot
+ *        published by the receiver thread at the end of the receive event which changed the table.
+ *        Tables larger than MAX_UNTHROTTLED_ENTRIES are copied at most once per MIN_PUBLISH_INTERVAL_NS,
+ *        changes in between are published by a later receive event or by the next housekeeping tick.
+ */
 class ARPTable : public IPrinter {
 public:
-    ARPTable() {}
+    /**
+     * @struct Snapshot
+     * @brief copy of the entries at a version of the table
+     */
+    struct Snapshot {
+        uint64_t version;
+        std::vector<ARPEntry> entries;
+    };
+
+    static constexpr uint32_t INITIAL_CAPACITY = 16;
+    static constexpr uint32_t MAX_PENDING_PACKETS = 8;
+    static constexpr uint32_t MAX_RESOLUTION_RETRIES = 3;
+    static constexpr uint32_t MAX_UNTHROTTLED_ENTRIES = 256;
+    static constexpr uint64_t MIN_PUBLISH_INTERVAL_NS = 10000000;
+
+    ARPTable();
+
+    /**
+     * @brief Destroy the ARPTable object. packets waiting for resolution are released.
+     *
+     */
+    ~ARPTable();
 
     static ARPTable *getNewTable()
     {
         return new ARPTable();
     }
 
+    /**
+     * @brief adds the entry, or updates the entry of the same IP address.
+     *
+     * @param arp_entry entry to be copied into the table
+     * @return true if the table has been changed
+     * @return false if the same entry already exists, or the IP address is 0.0.0.0
+     */
     bool addEntry(ARPEntry *arp_entry);
-    ARPEntry *arpTableLookup(const std::string &ip_addr);
+
+    /**
+     * @brief finds the entry of `ip_addr`.
+     *
+     * @param ip_addr IP address
+     * @return ARPEntry* entry stored in the table, valid until the table is modified. nullptr if not found.
+     */
+    ARPEntry *arpTableLookup(const IPAddress &ip_addr);
+
+    ARPEntry *arpTableLookup(const std::string &ip_addr)
+    {
+        return arpTableLookup(IPAddress(ip_addr));
+    }
+
+    /**
+     * @brief completes the entry of the sender of the reply and sends the packets waiting for it.
+     *        packets still referenced by others are copied before their destination MAC address is filled.
+     *
+     * @param arp_header ARP reply
+     * @param iif interface the reply was received on
+     */
     void updateFromARPReply(ARPHeader *arp_header, Interface *iif);
-    void deleteEntry(const std::string &ip_addr);
 
+    /**
+     * @brief holds `packet` until `ip_addr` is resolved. the first packet to an address adds an incomplete
+     *        entry and broadcasts an ARP request out of `oif`, later packets just join the queue.
+     *
+     * @param ip_addr next hop IP address, which must not have a complete entry
+     * @param oif interface on the subnet of `ip_addr`
+     * @param packet ethernet frame whose destination MAC address is filled on resolution.
+     *               the caller keeps its reference.
+     * @return true if the packet is queued
+     * @return false if the queue of the address is full and the packet is dropped
+     */
+    bool queuePendingPacket(const IPAddress &ip_addr, Interface *oif, PacketBuffer *packet);
+
+    /**
+     * @brief resolves `ip_addr` without a packet waiting for it. an unknown address gets an incomplete entry
+     *        and an ARP request broadcast out of `oif`, an address already being resolved is left to its
+     *        resolution in progress, and a resolved address needs nothing.
+     *
+     * @param ip_addr IP address to be resolved
+     * @param oif interface on the subnet of `ip_addr`
+     * @return true if the address is resolved or being resolved
+     * @return false if the IP address is 0.0.0.0
+     */
+    bool resolve(const IPAddress &ip_addr, Interface *oif);
+
+    /**
+     * @brief retransmits ARP requests whose backoff has elapsed, and abandons resolutions out of retries
+     *        along with their packets. expected to be called every second by the thread modifying the table.
+     *
+     */
+    void retryPendingResolutions();
+
+    /**
+     * @brief returns the number of packets dropped while waiting for resolution. safe to call from any thread.
+     *
+     * @return uint64_t
+     */
+    uint64_t getPendingDropCount() const
+    {
+        return pending_drop_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief removes the entry of `ip_addr`. packets waiting for its resolution are dropped.
+     *
+     * @param ip_addr IP address
+     */
+    void deleteEntry(const IPAddress &ip_addr);
+
+    void deleteEntry(const std::string &ip_addr)
+    {
+        deleteEntry(IPAddress(ip_addr));
+    }
+
+    uint32_t getEntryCount() const
+    {
+        return entries.size();
+    }
+
+    /**
+     * @brief publishes a snapshot of the entries if the table has changed since the last publication.
+     *        called by the thread modifying the table.
+     *
+     */
+    void publishSnapshot();
+
+    /**
+     * @brief publishes a snapshot if the table has changed. a table larger than MAX_UNTHROTTLED_ENTRIES is
+     *        left as is while its last snapshot is younger than MIN_PUBLISH_INTERVAL_NS.
+     *        called by the thread modifying the table at the end of each receive event.
+     *
+     */
+    void publishSnapshotIfDue();
+
+    /**
+     * @brief calls `reader` with the latest snapshot without blocking the thread modifying the table.
+     *
+     * @param reader callback taking `const Snapshot *`
+     */
+    template <typename Reader>
+    void readSnapshot(Reader &&reader) const
+    {
+        snapshot.read(std::forward<Reader>(reader));
+    }
+
+    /**
+     * @brief outputs the latest snapshot on the standard output. safe to call from any thread.
+     *
+     */
     virtual void dump() const override;
 
 private:
-    std::list<ARPEntry> arp_table;
+    // 0.0.0.0 is never resolved, so it marks empty slots
+    static constexpr uint32_t EMPTY_KEY = 0;
+
+    /**
+     * @brief resolution of an incomplete entry
+     *
+     */
+    struct PendingResolution {
+        Interface *oif;
+        std::vector<PacketBuffer *> packets; /* referenced until sent or dropped */
+        uint32_t retry_count;
+        uint32_t retry_interval;  /* in ticks of retryPendingResolutions, doubled on every retry */
+        uint64_t next_retry_tick;
+    };
+
+    using PendingResolutionMap = std::unordered_map<uint32_t, PendingResolution>;
+
+    /**
+     * @brief adds an incomplete entry for `ip_addr` and starts tracking its resolution. no request is sent.
+     *
+     * @param ip_addr IP address, which must not be in the table
+     * @param oif interface on the subnet of `ip_addr`
+     * @return PendingResolutionMap::iterator resolution. end of the map if the entry cannot be added.
+     */
+    PendingResolutionMap::iterator addPendingResolution(const IPAddress &ip_addr, Interface *oif);
+
+    /**
+     * @brief releases the packets of the resolution of `key` and forgets it.
+     *
+     * @param key IP address
+     */
+    void dropPendingResolution(uint32_t key);
+
+    OpenAddressingTable<uint32_t, ARPEntry, EMPTY_KEY> entries;
+
+    // touched only when an address is unresolved, so kept apart from the entries
+    PendingResolutionMap pending_resolutions;
+    uint64_t retry_tick;
+    std::atomic<uint64_t> pending_drop_count; /* read by the CLI */
+
+    // bumped whenever an entry is added, updated or removed
+    uint64_t version;
+    uint64_t published_version;
+    uint64_t published_time_ns; /* monotonic clock */
+    RCUSnapshot<Snapshot> snapshot;
 };
 
 ARPTable *getNewARPTable();
 void deleteARPTable(ARPTable *arp_table);
+
+/**
+ * @brief runs the periodic work of the L2 tables of `node` : MAC aging, ARP retries and snapshot publication.
+ *        called every second by the receiver thread of the node.
+ *
+ * @param node node
+ */
+void layer2RunPeriodicTasks(Node *node);
+
+/**
+ * @brief publishes the snapshots of the L2 tables of `node` which have changed, so that the CLI sees
+ *        new entries right away. called by the receiver thread of the node at the end of each receive event.
+ *
+ * @param node node
+ */
+void layer2PublishSnapshots(Node *node);
+/**
+ * @brief broadcasts an ARP request resolving `ip_addr`.
+ *
+ * @param node node sending the request
+ * @param oif interface sending the request. nullptr to pick the interface on the subnet of `ip_addr`.
+ * @param ip_addr IP address to be resolved
+ */
+void sendARPBroadcastRequest(Node *node, Interface *oif, const IPAddress &ip_addr);
 void sendARPBroadcastRequest(Node *node, Interface *oif, const std::string &ip_addr);
+
+/**
+ * @brief resolves `ip_addr` through the ARP table of `node`, out of the interface on its subnet.
+ *        concurrent resolutions of the same address share a single request.
+ *        called by the receiver thread of the node only.
+ *
+ * @param node resolving node
+ * @param ip_addr IP address to be resolved
+ */
+void layer2ResolveARP(Node *node, const IPAddress &ip_addr);
+
+/**
+ * @brief sends an IP packet from `node` to `ip_addr` on a directly connected subnet. the packet waits
+ *        for the resolution of `ip_addr` if needed. called by the receiver thread of the node only.
+ *
+ * @param node sending node
+ * @param ip_addr destination IP address
+ */
+void layer2SendPing(Node *node, const IPAddress &ip_addr);
+
+/**
+ * @brief encapsulates `packet` in an ethernet frame of `type` and sends it to the next hop `next_hop_ip`.
+ *        if the next hop is not resolved yet, the frame waits in the ARP table until it is.
+ *        called by the receiver thread of the node only.
+ *
+ * @param node sending node
+ * @param oif interface on the subnet of `next_hop_ip`
+ * @param next_hop_ip IP address of the next hop
+ * @param packet payload of the frame. the caller keeps its reference.
+ * @param type ether type of the payload
+ */
+void sendPacketToNextHop(Node *node, Interface *oif, const IPAddress &next_hop_ip, PacketBuffer *packet, uint16_t type);
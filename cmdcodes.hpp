@@ -12,3 +12,11 @@
 #define CMDCODE_RUN_RESOLVE_ARP         2
 #define CMDCODE_SHOW_ARP                3
 #define CMDCODE_SHOW_MAC                4
+#define CMDCODE_SHOW_EGRESS_BATCH       5
+#define CMDCODE_CONFIG_TRANSPORT        6
+#define CMDCODE_CONFIG_INTF_MTU         7
+#define CMDCODE_SHOW_STORM_CONTROL      8
+#define CMDCODE_CONFIG_INTF_STORM_CONTROL 9
+#define CMDCODE_CONFIG_EGRESS_BATCH     10
+#define CMDCODE_CONFIG_LINK_HEADER      11
+#define CMDCODE_RUN_PING                12
@@ -9,24 +9,252 @@
 #include "comm.hpp"
 
 #include <arpa/inet.h>
-#include <netdb.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-char recv_buffer[MAX_PACKET_BUFFER_SIZE];
-char send_buffer[MAX_PACKET_BUFFER_SIZE];
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "packet_buffer.hpp"
+
+bool LinkHeader::tryParseFormat(const std::string &name, Format *format)
+{
+    for (Format candidate : { Format::COMPACT, Format::LEGACY_NAME }) {
+        if (getFormatName(candidate) == name) {
+            *format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *LinkHeader::getFormatName(Format format)
+{
+    switch (format) {
+    case Format::COMPACT:
+        return "compact";
+    case Format::LEGACY_NAME:
+        return "legacy";
+    }
+    return "";
+}
+
+int openTransmitSocket()
+{
+    return socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+}
+
+void getLoopbackSocketAddress(uint32_t udp_port_no, sockaddr_in *addr)
+{
+    memset(addr, 0, sizeof(sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_port = udp_port_no;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+int sendPacketOut(int sock_fd, const char *pkt_data, uint32_t pkt_size, const sockaddr_in &dst_addr)
+{
+    return sendto(sock_fd, pkt_data, pkt_size, 0, reinterpret_cast<const sockaddr *>(&dst_addr), sizeof(sockaddr_in));
+}
+
+int sendPacketOut(int sock_fd, const iovec *segments, uint32_t segment_count, const sockaddr_in &dst_addr)
+{
+    msghdr hdr;
+    memset(&hdr, 0, sizeof(msghdr));
+    hdr.msg_name = const_cast<sockaddr_in *>(&dst_addr);
+    hdr.msg_namelen = sizeof(sockaddr_in);
+    hdr.msg_iov = const_cast<iovec *>(segments);
+    hdr.msg_iovlen = segment_count;
+    return sendmsg(sock_fd, &hdr, 0);
+}
 
 int sendPacketOut(int sock_fd, char *pkt_data, uint32_t pkt_size, uint32_t dst_udp_port_no)
 {
     sockaddr_in dest_addr;
+    getLoopbackSocketAddress(dst_udp_port_no, &dest_addr);
+
+    return sendPacketOut(sock_fd, pkt_data, pkt_size, dest_addr);
+}
+
+EgressBatch::EgressBatch(uint32_t batch_size) :
+    sock_fd(-1),
+    batch_size(0),
+    pending(0),
+    flush_count(0),
+    sent_frame_count(0),
+    send_error_count(0)
+{
+    setBatchSize(batch_size);
+}
+
+void EgressBatch::setBatchSize(uint32_t batch_size)
+{
+    flush();
+
+    this->batch_size = std::min(std::max(batch_size, 1u), MAX_BATCH_SIZE);
+    aux_buffers.resize(this->batch_size);
+    packets.assign(this->batch_size, nullptr);
+    iovs.resize(this->batch_size * MAX_IOVS_PER_FRAME);
+    iov_counts.resize(this->batch_size);
+    dst_addrs.resize(this->batch_size);
+    msgs.resize(this->batch_size);
+}
+
+void EgressBatch::close()
+{
+    flush();
+    if (open_batch == this) {
+        open_batch = nullptr;
+    }
+}
+
+int EgressBatch::enqueue(const char *aux_data, uint32_t aux_size, const EgressFrame &frame, const sockaddr_in &dst_addr)
+{
+    static_assert(1 + EgressFrame::MAX_SEGMENTS <= MAX_IOVS_PER_FRAME, "aux data and all the segments of a frame need an iovec");
 
-    hostent *host = reinterpret_cast<hostent *>(gethostbyname("127.0.0.1"));
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = dst_udp_port_no;
-    dest_addr.sin_addr = *(reinterpret_cast<in_addr *>(host->h_addr));
+    if (aux_size > LinkHeader::MAX_SIZE) {
+        return -1;
+    }
 
-    int rc = sendto(sock_fd, pkt_data, pkt_size, 0, reinterpret_cast<sockaddr *>(&dest_addr), sizeof(sockaddr));
+    char *aux_buffer = aux_buffers[pending].data();
+    memcpy(aux_buffer, aux_data, aux_size);
+
+    iovec *iov = &iovs[pending * MAX_IOVS_PER_FRAME];
+    iov[0].iov_base = aux_buffer;
+    iov[0].iov_len = aux_size;
+    iov_counts[pending] = 1 + frame.getSegments(iov + 1);
+
+    // the frame is sent from its own buffer, keep it alive until the batch is flushed
+    frame.packet->retain();
+    packets[pending] = frame.packet;
+    dst_addrs[pending] = dst_addr;
+    pending++;
+
+    uint32_t size = aux_size + frame.getLength();
+    if (pending == batch_size) {
+        flush();
+    }
+
+    return size;
+}
+
+int EgressBatch::flush()
+{
+    if (!pending) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < pending; i++) {
+        msghdr &hdr = msgs[i].msg_hdr;
+        memset(&hdr, 0, sizeof(msghdr));
+        hdr.msg_name = &dst_addrs[i];
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &iovs[i * MAX_IOVS_PER_FRAME];
+        hdr.msg_iovlen = iov_counts[i];
+    }
+
+    uint32_t sent = 0;
+    uint32_t errors = 0;
+    for (uint32_t next = 0; next < pending;) {
+        int rc = sendmmsg(sock_fd, &msgs[next], pending - next, 0);
+        if (rc <= 0) {
+            // sendmmsg stops at the first failing message : drop that one and send the rest
+            errors++;
+            next++;
+            continue;
+        }
+        sent += rc;
+        next += rc;
+    }
+
+    for (uint32_t i = 0; i < pending; i++) {
+        packets[i]->release();
+        packets[i] = nullptr;
+    }
+
+    // the batch is the only writer, so the counters need no read-modify-write
+    flush_count.store(flush_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sent_frame_count.store(sent_frame_count.load(std::memory_order_relaxed) + sent, std::memory_order_relaxed);
+    send_error_count.store(send_error_count.load(std::memory_order_relaxed) + errors, std::memory_order_relaxed);
+    pending = 0;
+
+    return sent;
+}
+
+void EgressBatch::dump() const
+{
+    std::cout <<
+        "Egress batch size : " << batch_size <<
+        ", flushes : " << flush_count.load(std::memory_order_relaxed) <<
+        ", frames sent : " << sent_frame_count.load(std::memory_order_relaxed) <<
+        ", send errors : " << send_error_count.load(std::memory_order_relaxed) <<
+        ", average fill : " << getAverageFill() <<
+        std::endl;
+}
+
+IngressBurst::IngressBurst(uint32_t burst_size, uint32_t max_frame_size) :
+    burst_size(0),
+    max_frame_size(PacketBuffer::getMaxFrameSize(PacketBuffer::getSizeClass(max_frame_size))),
+    frame_count(0)
+{
+    setBurstSize(burst_size);
+}
+
+IngressBurst::~IngressBurst()
+{
+    for (auto &frame : frames) {
+        frame->release();
+    }
+}
+
+void IngressBurst::setBurstSize(uint32_t burst_size)
+{
+    for (auto &frame : frames) {
+        frame->release();
+    }
+
+    this->burst_size = std::max(burst_size, 1u);
+    frame_count = 0;
+    frames.assign(this->burst_size, nullptr);
+    iovs.resize(this->burst_size);
+    msgs.resize(this->burst_size);
+
+    for (uint32_t i = 0; i < this->burst_size; i++) {
+        frames[i] = PacketBuffer::allocate(PacketBuffer::getSizeClass(max_frame_size));
+        iovs[i].iov_base = frames[i]->getData();
+        iovs[i].iov_len = max_frame_size;
+
+        msghdr &hdr = msgs[i].msg_hdr;
+        memset(&hdr, 0, sizeof(msghdr));
+        hdr.msg_iov = &iovs[i];
+        hdr.msg_iovlen = 1;
+    }
+}
+
+void IngressBurst::recycleFrame(uint32_t i)
+{
+    if (frames[i]->isShared()) {
+        frames[i]->release();
+        frames[i] = PacketBuffer::allocate(PacketBuffer::getSizeClass(max_frame_size));
+        iovs[i].iov_base = frames[i]->getData();
+        return;
+    }
+    frames[i]->reset();
+}
+
+int IngressBurst::receive(int sock_fd)
+{
+    // only the slots filled by the last call have been handed out
+    for (uint32_t i = 0; i < frame_count; i++) {
+        recycleFrame(i);
+    }
 
-    return rc;
+    int rc = recvmmsg(sock_fd, msgs.data(), burst_size, MSG_DONTWAIT, nullptr);
+    frame_count = rc > 0 ? rc : 0;
+    for (uint32_t i = 0; i < frame_count; i++) {
+        frames[i]->setLength(msgs[i].msg_len);
+    }
+    return frame_count;
 }
@@ -8,12 +8,103 @@
 
 #pragma once
 
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <string>
+#include <vector>
+
+#include "printer.hpp"
+
+ // forward declaration
+class PacketBuffer;
+struct EgressFrame;
+
+// large enough for the link header and a VLAN tagged ethernet frame carrying DEFAULT_MTU bytes of payload
+#define STANDARD_PACKET_BUFFER_SIZE 1600
+// large enough for the link header and a VLAN tagged ethernet frame carrying MAX_MTU bytes of payload (jumbo frame)
+#define MAX_PACKET_BUFFER_SIZE  9216
+
+/**
+ * @struct LinkHeader
+ * @brief header prepended to every frame sent over a node socket.
+ *        It addresses the receiving interface by its index on the receiving node.
+ *        Frames of the legacy format carry the NUL padded name of the receiving interface instead.
+ *        Interface names are ASCII, so the first byte of a legacy frame never equals `MAGIC`.
+ */
+#pragma pack(push, 1)
+struct LinkHeader {
+    uint8_t magic;
+    uint8_t reserved;
+    uint16_t ifindex;
+
+    static constexpr uint8_t MAGIC = 0xA5;
+    static constexpr uint32_t LEGACY_SIZE = 16;
+    static constexpr uint32_t MAX_SIZE = LEGACY_SIZE;
+
+    /**
+     * @brief format of the header written by the sending interface
+     *
+     */
+    enum class Format {
+        COMPACT,     /* LinkHeader addressing the interface index */
+        LEGACY_NAME, /* 16-byte NUL padded interface name */
+    };
 
-#define MAX_PACKET_BUFFER_SIZE  2048
+    /**
+     * @brief finds the header format by its name.
+     *
+     * @param name name of the format (compact, legacy)
+     * @param format output format
+     * @return true if `name` matches with a format
+     * @return false otherwise
+     */
+    static bool tryParseFormat(const std::string &name, Format *format);
 
-extern char recv_buffer[MAX_PACKET_BUFFER_SIZE];
-extern char send_buffer[MAX_PACKET_BUFFER_SIZE];
+    static const char *getFormatName(Format format);
+};
+#pragma pack(pop)
+
+/**
+ * @brief opens a UDP socket which is used only for transmission.
+ *
+ * @return int file descriptor of the socket. negative value on failure.
+ */
+int openTransmitSocket();
+
+/**
+ * @brief fills `addr` with the loopback address and the UDP port number `udp_port_no`.
+ *
+ * @param udp_port_no destination UDP port number
+ * @param addr socket address to be filled
+ */
+void getLoopbackSocketAddress(uint32_t udp_port_no, sockaddr_in *addr);
+
+/**
+ * @brief sends UDP packet `pkt_data` from file descriptor `sock_fd` to the pre-resolved address `dst_addr`.
+ *
+ * @param sock_fd file descriptor
+ * @param pkt_data raw packet data
+ * @param pkt_size size of the data
+ * @param dst_addr destination socket address
+ * @return int size of the sent data
+ */
+int sendPacketOut(int sock_fd, const char *pkt_data, uint32_t pkt_size, const sockaddr_in &dst_addr);
+
+/**
+ * @brief sends a UDP packet gathered from `segment_count` segments from file descriptor `sock_fd` to `dst_addr`.
+ *
+ * @param sock_fd file descriptor
+ * @param segments pieces of the packet, sent back to back
+ * @param segment_count number of segments
+ * @param dst_addr destination socket address
+ * @return int size of the sent data
+ */
+int sendPacketOut(int sock_fd, const iovec *segments, uint32_t segment_count, const sockaddr_in &dst_addr);
 
 /**
  * @brief sends UDP packet `pkt_data` from file descriptor `sock_fd`.
@@ -25,3 +116,231 @@ extern char send_buffer[MAX_PACKET_BUFFER_SIZE];
  * @return int size of the sent data
  */
 int sendPacketOut(int sock_fd, char *pkt_data, uint32_t pkt_size, uint32_t dst_udp_port_no);
+
+/**
+ * @class EgressBatch
+ * @brief collects outgoing UDP frames and sends them with a single sendmmsg call.
+ *        While the batch is open, frames are queued instead of being sent one by one.
+ *        Queued frames are flushed when the batch is closed or when it gets full.
+ */
+class EgressBatch : public IPrinter {
+public:
+    static constexpr uint32_t DEFAULT_BATCH_SIZE = 32;
+    // a single sendmmsg call sends up to UIO_MAXIOV messages
+    static constexpr uint32_t MAX_BATCH_SIZE = 1024;
+
+    /**
+     * @brief Construct a new EgressBatch object
+     *
+     * @param batch_size maximum number of frames to be queued before flushing
+     */
+    explicit EgressBatch(uint32_t batch_size = DEFAULT_BATCH_SIZE);
+
+    /**
+     * @brief sets the socket used for flushing the batch
+     *
+     * @param sock_fd file descriptor
+     */
+    void setSocketFileDescriptor(int sock_fd)
+    {
+        this->sock_fd = sock_fd;
+    }
+
+    /**
+     * @brief sets the maximum number of frames to be queued. pending frames are flushed first.
+     *        batch size 1 effectively disables batching.
+     *
+     * @param batch_size maximum number of frames to be queued, clamped to 1 - MAX_BATCH_SIZE
+     */
+    void setBatchSize(uint32_t batch_size);
+
+    uint32_t getBatchSize() const
+    {
+        return batch_size;
+    }
+
+    /**
+     * @brief starts collecting frames on the calling thread.
+     *        frames sent by other threads are not affected.
+     *
+     */
+    void open()
+    {
+        open_batch = this;
+    }
+
+    /**
+     * @brief flushes pending frames and stops collecting frames.
+     *
+     */
+    void close();
+
+    /**
+     * @brief checks whether the batch is collecting frames on the calling thread.
+     *
+     * @return true if the batch is opened by the calling thread
+     * @return false otherwise
+     */
+    bool isOpen() const
+    {
+        return open_batch == this;
+    }
+
+    /**
+     * @brief queues a frame which consists of `aux_data` followed by `frame`. flushes the batch when it gets full.
+     *        `aux_data` is copied, while the packet buffer of `frame` is referenced until the batch is flushed.
+     *
+     * @param aux_data auxiliary data prepended to the frame
+     * @param aux_size size of the auxiliary data, up to LinkHeader::MAX_SIZE
+     * @param frame frame to be sent
+     * @param dst_addr destination socket address
+     * @return int size of the queued data. -1 if `aux_data` is too large.
+     */
+    int enqueue(const char *aux_data, uint32_t aux_size, const EgressFrame &frame, const sockaddr_in &dst_addr);
+
+    /**
+     * @brief sends all the pending frames.
+     *
+     * @return int number of frames sent
+     */
+    int flush();
+
+    /**
+     * @brief returns average number of frames sent per flush.
+     *
+     * @return double
+     */
+    double getAverageFill() const
+    {
+        uint64_t flushes = flush_count.load(std::memory_order_relaxed);
+        return flushes ? static_cast<double>(sent_frame_count.load(std::memory_order_relaxed)) / flushes : 0.0;
+    }
+
+    /**
+     * @brief outputs batch configuration and counters on the standard output
+     *
+     */
+    virtual void dump() const override;
+
+private:
+    using AuxBuffer = std::array<char, LinkHeader::MAX_SIZE>;
+
+    // auxiliary data followed by the segments of an EgressFrame
+    static constexpr uint32_t MAX_IOVS_PER_FRAME = 3;
+
+    int sock_fd;
+    uint32_t batch_size;
+    uint32_t pending;
+
+    // batch currently collecting frames on this thread
+    inline static thread_local const EgressBatch *open_batch = nullptr;
+
+    std::vector<AuxBuffer> aux_buffers;
+    std::vector<PacketBuffer *> packets; /* referenced until flushed */
+    std::vector<iovec> iovs;             /* MAX_IOVS_PER_FRAME per frame */
+    std::vector<uint32_t> iov_counts;
+    std::vector<sockaddr_in> dst_addrs;
+    std::vector<mmsghdr> msgs;
+
+    /* counters, written by the receiver thread and read by the CLI */
+    std::atomic<uint64_t> flush_count;
+    std::atomic<uint64_t> sent_frame_count;
+    std::atomic<uint64_t> send_error_count;
+};
+
+/**
+ * @class IngressBurst
+ * @brief receives up to `burst_size` UDP frames from a socket with a single recvmmsg call
+ *        directly into pooled packet buffers, behind their headroom.
+ *        Buffers are of the smallest size class holding `max_frame_size` bytes, so sockets receiving
+ *        jumbo frames need a burst of their own.
+ */
+class IngressBurst {
+public:
+    static constexpr uint32_t DEFAULT_BURST_SIZE = 32;
+
+    /**
+     * @brief Construct a new IngressBurst object
+     *
+     * @param burst_size maximum number of frames received at once
+     * @param max_frame_size size of the largest frame to be received, up to MAX_PACKET_BUFFER_SIZE
+     */
+    explicit IngressBurst(uint32_t burst_size = DEFAULT_BURST_SIZE, uint32_t max_frame_size = STANDARD_PACKET_BUFFER_SIZE);
+
+    /**
+     * @brief Destroy the IngressBurst object. buffers go back to the pool of the calling thread.
+     *
+     */
+    ~IngressBurst();
+
+    IngressBurst(const IngressBurst &) = delete;
+    IngressBurst &operator=(const IngressBurst &) = delete;
+
+    /**
+     * @brief sets the maximum number of frames received at once. 1 reads a single frame per call.
+     *
+     * @param burst_size maximum number of frames received at once
+     */
+    void setBurstSize(uint32_t burst_size);
+
+    uint32_t getBurstSize() const
+    {
+        return burst_size;
+    }
+
+    /**
+     * @brief returns the size of the largest frame the buffers hold, which may exceed the requested one.
+     *
+     * @return uint32_t
+     */
+    uint32_t getMaxFrameSize() const
+    {
+        return max_frame_size;
+    }
+
+    /**
+     * @brief receives pending frames from `sock_fd` without blocking.
+     *        buffers of previously received frames are reused unless someone else still holds them.
+     *
+     * @param sock_fd file descriptor
+     * @return int number of frames received
+     */
+    int receive(int sock_fd);
+
+    /**
+     * @brief returns the number of frames held by the last `receive` call
+     *
+     * @return uint32_t
+     */
+    uint32_t getFrameCount() const
+    {
+        return frame_count;
+    }
+
+    /**
+     * @brief returns i-th frame of the burst, including its link header.
+     *
+     * @param i index of the frame
+     * @return PacketBuffer*. the burst keeps its reference.
+     */
+    PacketBuffer *getFrame(uint32_t i)
+    {
+        return frames[i];
+    }
+
+private:
+    /**
+     * @brief prepares the buffer of i-th slot for the next receive.
+     *
+     * @param i index of the slot
+     */
+    void recycleFrame(uint32_t i);
+
+    uint32_t burst_size;
+    uint32_t max_frame_size;
+    uint32_t frame_count;
+
+    std::vector<PacketBuffer *> frames;
+    std::vector<iovec> iovs;
+    std::vector<mmsghdr> msgs;
+};
@@ -0,0 +1,103 @@
+/**
+ * @file event_loop.cpp
+ * @author Jayson Sho Toma
+ * @brief epoll based event loop which dispatches readiness of file descriptors to their handlers.
+ * @version 0.1
+ * @date 2022-05-06
+ */
+
+#include "event_loop.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <iostream>
+
+EventLoop::EventLoop() :
+    epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+    post_dispatch_handler(nullptr)
+{
+    if (epoll_fd < 0) {
+        std::cout << "Error : epoll_create1() failed, errno = " << errno << std::endl;
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    epoll_fd = -1;
+}
+
+bool EventLoop::addFileDescriptor(int fd, uint32_t events, EventHandler handler)
+{
+    std::lock_guard<std::mutex> lock(registration_mutex);
+
+    if (registrations.count(fd)) {
+        return false;
+    }
+
+    std::unique_ptr<Registration> registration(new Registration{ fd, true, std::move(handler) });
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.ptr = registration.get();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        std::cout << "Error : epoll_ctl() failed for fd " << fd << ", errno = " << errno << std::endl;
+        return false;
+    }
+
+    registrations.emplace(fd, std::move(registration));
+    return true;
+}
+
+bool EventLoop::removeFileDescriptor(int fd)
+{
+    std::lock_guard<std::mutex> lock(registration_mutex);
+
+    auto result = registrations.find(fd);
+    if (result == std::end(registrations)) {
+        return false;
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    result->second->is_active = false;
+    retired_registrations.push_back(std::move(result->second));
+    registrations.erase(result);
+    return true;
+}
+
+int EventLoop::runOnce(int timeout_ms)
+{
+    epoll_event events[MAX_EVENTS_PER_WAKEUP];
+
+    int n_events = epoll_wait(epoll_fd, events, MAX_EVENTS_PER_WAKEUP, timeout_ms);
+    if (n_events < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (int i = 0; i < n_events; i++) {
+        Registration *registration = static_cast<Registration *>(events[i].data.ptr);
+        if (!registration->is_active) {
+            continue;
+        }
+        registration->handler(events[i].events);
+    }
+
+    if (post_dispatch_handler) {
+        post_dispatch_handler();
+    }
+
+    std::lock_guard<std::mutex> lock(registration_mutex);
+    retired_registrations.clear();
+
+    return n_events;
+}
+
+void EventLoop::run()
+{
+    while (runOnce(-1) >= 0) {
+    }
+    std::cout << "Error : epoll_wait() failed, errno = " << errno << std::endl;
+}
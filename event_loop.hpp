@@ -0,0 +1,110 @@
+/**
+ * @file event_loop.hpp
+ * @author Jayson Sho Toma
+ * @brief epoll based event loop which dispatches readiness of file descriptors to their handlers.
+ * @version 0.1
+ * @date 2022-05-06
+ */
+
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class EventLoop
+ * @brief waits on registered file descriptors with epoll and calls the handler of each ready descriptor.
+ *        A wakeup costs O(number of ready descriptors) regardless of how many descriptors are registered.
+ *        Sockets, timerfds and eventfds can be registered alike.
+ */
+class EventLoop {
+public:
+    /**
+     * @brief callback invoked with the ready epoll events (EPOLLIN, EPOLLOUT, ...)
+     *
+     */
+    using EventHandler = std::function<void(uint32_t events)>;
+
+    /**
+     * @brief Construct a new EventLoop object
+     *
+     */
+    EventLoop();
+
+    /**
+     * @brief Destroy the EventLoop object. Registered descriptors are NOT closed.
+     *
+     */
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    /**
+     * @brief registers `fd` to the loop.
+     *
+     * @param fd file descriptor to be watched
+     * @param events epoll events to be watched
+     * @param handler callback invoked when `fd` gets ready
+     * @return true if registration succeeds
+     * @return false if `fd` is already registered or epoll_ctl fails
+     */
+    bool addFileDescriptor(int fd, uint32_t events, EventHandler handler);
+
+    /**
+     * @brief unregisters `fd` from the loop. It is safe to call this from a handler.
+     *
+     * @param fd file descriptor to be unregistered
+     * @return true if `fd` was registered
+     * @return false otherwise
+     */
+    bool removeFileDescriptor(int fd);
+
+    /**
+     * @brief sets a callback invoked after every dispatch round.
+     *        used for flushing work accumulated by the handlers, e.g. submitting queued I/O at once.
+     *
+     * @param handler callback. nullptr unsets the callback.
+     */
+    void setPostDispatchHandler(std::function<void()> handler)
+    {
+        post_dispatch_handler = std::move(handler);
+    }
+
+    /**
+     * @brief waits for ready descriptors once and dispatches them.
+     *
+     * @param timeout_ms timeout in milliseconds. -1 blocks until an event occurs.
+     * @return int number of dispatched events. -1 on error.
+     */
+    int runOnce(int timeout_ms);
+
+    /**
+     * @brief dispatches events forever.
+     *
+     */
+    void run();
+
+private:
+    struct Registration {
+        int fd;
+        std::atomic<bool> is_active;
+        EventHandler handler;
+    };
+
+    static constexpr int MAX_EVENTS_PER_WAKEUP = 64;
+
+    int epoll_fd;
+    std::function<void()> post_dispatch_handler;
+    std::mutex registration_mutex;
+    std::unordered_map<int, std::unique_ptr<Registration>> registrations;
+    // removed registrations are kept until the current dispatch round finishes
+    std::vector<std::unique_ptr<Registration>> retired_registrations;
+};
@@ -0,0 +1,88 @@
+/**
+ * @file frame_ring.cpp
+ * @author Jayson Sho Toma
+ * @brief lock-free single-producer/single-consumer ring which carries frames between interfaces in the same process.
+ * @version 0.1
+ * @date 2022-05-06
+ */
+
+#include "frame_ring.hpp"
+
+#include "packet_buffer.hpp"
+
+FrameRing::FrameRing(uint32_t capacity) :
+    mask(0),
+    slots(),
+    head(0),
+    tail(0),
+    drop_count(0)
+{
+    uint32_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    mask = size - 1;
+    slots.resize(size);
+}
+
+FrameRing::~FrameRing()
+{
+    for (uint32_t h = head.load(); h != tail.load(); h++) {
+        if (PacketBuffer *packet = slots[h & mask].packet; packet) {
+            packet->release();
+        }
+    }
+}
+
+char *FrameRing::reserve()
+{
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) > mask) {
+        return nullptr;
+    }
+    return slots[t & mask].data;
+}
+
+bool FrameRing::commit(uint32_t size)
+{
+    Slot &slot = slots[tail.load(std::memory_order_relaxed) & mask];
+    slot.size = size;
+    slot.packet = nullptr;
+    return publish();
+}
+
+bool FrameRing::commitPacket(PacketBuffer *packet)
+{
+    Slot &slot = slots[tail.load(std::memory_order_relaxed) & mask];
+    slot.size = packet->getLength();
+    slot.packet = packet;
+    return publish();
+}
+
+bool FrameRing::publish()
+{
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    tail.store(t + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // the consumer has drained everything up to this frame only if it is the sole frame left
+    return head.load(std::memory_order_acquire) == t;
+}
+
+PacketBuffer *FrameRing::pop()
+{
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+        // pairs with the fence in `publish` : either this load observes the new frame,
+        // or the producer observes the released slot and notifies the consumer.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+    }
+
+    Slot &slot = slots[h & mask];
+    PacketBuffer *packet = slot.packet ? slot.packet : PacketBuffer::allocate(slot.data, slot.size);
+    slot.packet = nullptr;
+    head.store(h + 1, std::memory_order_release);
+    return packet;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file frame_ring.hpp
+ * @author Jayson Sho Toma
+ * @brief lock-free single-producer/single-consumer ring which carries frames between interfaces in the same process.
+ * @version 0.1
+ * @date 2022-05-06
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "comm.hpp"
+
+class PacketBuffer;
+
+/**
+ * @class FrameRing
+ * @brief fixed-size ring of frame slots. Each slot holds a frame of up to SLOT_SIZE bytes, which covers
+ *        the default MTU. Larger (jumbo) frames are passed by reference to a private packet buffer instead,
+ *        so the ring never reserves jumbo-sized memory for frames which may never come.
+ *        Producer calls `reserve` then `commit` or `commitPacket`, consumer calls `pop`.
+ */
+class FrameRing {
+public:
+    static constexpr uint32_t DEFAULT_CAPACITY = 64;
+    static constexpr uint32_t SLOT_SIZE = STANDARD_PACKET_BUFFER_SIZE;
+
+    /**
+     * @brief Construct a new FrameRing object
+     *
+     * @param capacity number of slots. rounded up to a power of two.
+     */
+    explicit FrameRing(uint32_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * @brief Destroy the FrameRing object. packets of frames not consumed yet are released.
+     *
+     */
+    ~FrameRing();
+
+    FrameRing(const FrameRing &) = delete;
+    FrameRing &operator=(const FrameRing &) = delete;
+
+    /**
+     * @brief returns the next free slot. producer side.
+     *
+     * @return char* buffer of SLOT_SIZE bytes. nullptr if the ring is full.
+     */
+    char *reserve();
+
+    /**
+     * @brief publishes the slot returned by `reserve`. producer side.
+     *
+     * @param size size of the frame written into the slot
+     * @return true if the ring was empty, i.e. the consumer has to be notified
+     * @return false otherwise
+     */
+    bool commit(uint32_t size);
+
+    /**
+     * @brief publishes `packet` in the slot returned by `reserve`, for frames larger than SLOT_SIZE. producer side.
+     *        the ring takes over the reference, so the packet must not be shared.
+     *
+     * @param packet private packet buffer holding the frame
+     * @return true if the ring was empty, i.e. the consumer has to be notified
+     * @return false otherwise
+     */
+    bool commitPacket(PacketBuffer *packet);
+
+    /**
+     * @brief takes the oldest published frame out of the ring. consumer side.
+     *
+     * @return PacketBuffer* packet holding the frame, whose reference goes to the caller. nullptr if the ring is empty.
+     */
+    PacketBuffer *pop();
+
+    /**
+     * @brief serializes producers. frames are normally produced only by the worker which owns the sending node,
+     *        but the CLI thread may originate frames too.
+     *
+     */
+    void lockProducer()
+    {
+        while (producer_lock.test_and_set(std::memory_order_acquire)) {
+        }
+    }
+
+    void unlockProducer()
+    {
+        producer_lock.clear(std::memory_order_release);
+    }
+
+    uint64_t getDropCount() const
+    {
+        return drop_count.load(std::memory_order_relaxed);
+    }
+
+    void countDrop()
+    {
+        drop_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        uint32_t size;
+        PacketBuffer *packet; /* frame larger than the slot, nullptr if the frame is in `data` */
+        char data[SLOT_SIZE];
+    };
+
+    /**
+     * @brief publishes the reserved slot.
+     *
+     * @return true if the ring was empty
+     * @return false otherwise
+     */
+    bool publish();
+
+    static constexpr uint32_t CACHE_LINE_SIZE = 64;
+
+    uint32_t mask;
+    std::vector<Slot> slots;
+
+    // written by the consumer
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> head;
+    // written by the producer
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> tail;
+    std::atomic_flag producer_lock = ATOMIC_FLAG_INIT;
+    std::atomic<uint64_t> drop_count;
+};
@@ -9,23 +9,46 @@
 #include "graph.hpp"
 
 #include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <random>
 #include <thread>
 
 #include "comm.hpp"
+#include "uring.hpp"
+#include "Layer2/layer2.hpp"
 
 Interface::Interface(const std::string &name) :
     if_name(name.substr(0, MAX_INTF_NAME_LENGTH)),
+    ifindex(0),
+    link_header_format(LinkHeader::Format::COMPACT),
     intf_network_property(),
     att_node(nullptr),
-    link(nullptr)
+    link(nullptr),
+    peer_intf(nullptr),
+    tx_sock_fd(-1),
+    peer_addr(),
+    ingress_ring(nullptr),
+    transport(ITransport::getTransport(ITransport::Type::UDP)),
+    ingress_handler(nullptr)
 {
+    updateIngressHandler();
+}
+
+Interface::~Interface()
+{
+    if (tx_sock_fd >= 0) {
+        close(tx_sock_fd);
+    }
+    tx_sock_fd = -1;
 }
 
 const Node *Interface::getNeighbourNode() const
@@ -50,6 +73,53 @@ const Node *Interface::getNeighbourNode() const
     return nullptr;
 }
 
+bool Interface::initTransmission()
+{
+    if (!link) {
+        return false;
+    }
+
+    peer_intf = link->getFromInterface() == this ? link->getToInterface() : link->getFromInterface();
+    const Node *neighbour_node = peer_intf->getNode();
+    if (!neighbour_node) {
+        return false;
+    }
+    getLoopbackSocketAddress(neighbour_node->getUDPPortNumber(), &peer_addr);
+
+    if (tx_sock_fd < 0) {
+        tx_sock_fd = openTransmitSocket();
+    }
+    if (tx_sock_fd < 0) {
+        std::cout << "Error : Sending socket creation failed, errno = " << errno << std::endl;
+        return false;
+    }
+    // connected socket lets transports send with plain write operations
+    if (connect(tx_sock_fd, reinterpret_cast<sockaddr *>(&peer_addr), sizeof(sockaddr_in)) < 0) {
+        std::cout << "Error : Sending socket connect failed, errno = " << errno << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint32_t Interface::encodeLinkHeader(char *buffer) const
+{
+    if (!peer_intf) {
+        return 0;
+    }
+
+    if (getLinkHeaderFormat() == LinkHeader::Format::LEGACY_NAME) {
+        memset(buffer, 0, LinkHeader::LEGACY_SIZE);
+        strncpy(buffer, peer_intf->getName().c_str(), LinkHeader::LEGACY_SIZE);
+        return LinkHeader::LEGACY_SIZE;
+    }
+
+    LinkHeader *link_header = reinterpret_cast<LinkHeader *>(buffer);
+    link_header->magic = LinkHeader::MAGIC;
+    link_header->reserved = 0;
+    link_header->ifindex = peer_intf->getIfIndex();
+    return sizeof(LinkHeader);
+}
+
 void Interface::assignMACAddress()
 {
     auto calcHashCode = [](const std::string &s) -> uint64_t {
@@ -69,11 +139,19 @@ void Interface::assignMACAddress()
 void Interface::setIPAddress(const std::string &ip_addr, char mask)
 {
     intf_network_property.setIPAddress(IPAddress(ip_addr), mask);
+    updateIngressHandler();
+    if (att_node) {
+        att_node->updateFloodPortSets();
+    }
 }
 
 void Interface::unsetIPAddress()
 {
     intf_network_property.unsetIPAddress();
+    updateIngressHandler();
+    if (att_node) {
+        att_node->updateFloodPortSets();
+    }
 }
 
 bool Interface::isL3Mode() const
@@ -81,51 +159,59 @@ bool Interface::isL3Mode() const
     return intf_network_property.isL3Mode();
 }
 
-int Interface::sendPacketOut(char *packet, uint32_t packet_size)
+bool Interface::setMTU(uint32_t mtu)
 {
-    const Node *neighbour_node = getNeighbourNode();
-
-    if (!neighbour_node) {
-        return -1;
+    if (mtu < MIN_MTU || mtu > MAX_MTU) {
+        std::cout << "Error : Interface " << if_name << " : MTU must be between " << MIN_MTU << " and " << MAX_MTU << std::endl;
+        return false;
     }
+    intf_network_property.setMTU(mtu);
+    return true;
+}
 
-    uint32_t dst_udp_port_no = neighbour_node->getUDPPortNumber();
+bool Interface::isFrameWithinMTU(const char *packet, uint32_t packet_size) const
+{
+    if (packet_size < ETH_HDR_SIZE_EXCL_PAYLOAD) {
+        return true;
+    }
+    EthernetHeader *ethernet_header = reinterpret_cast<EthernetHeader *>(const_cast<char *>(packet));
+    return packet_size - getEthernetHeaderSizeExcludingPayload(ethernet_header) <= getMTU();
+}
 
-    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sock < 0) {
-        std::cout << "Error : Sending socket creation failed, errno = " << errno << std::endl;
+int Interface::sendPacketOut(PacketBuffer *packet, bool strip_vlan_tag)
+{
+    if (!isFrameWithinMTU(packet->getData(), packet->getLength())) {
         return -1;
     }
 
-    Interface *other_interface = link->getFromInterface() == this ? link->getToInterface() : link->getFromInterface();
-    std::fill(std::begin(send_buffer), std::end(send_buffer), 0);
-
-    char *pkt_with_aux_data = send_buffer;
-    strncpy(pkt_with_aux_data, other_interface->getName().c_str(), MAX_INTF_NAME_LENGTH);
-    memcpy(pkt_with_aux_data + MAX_INTF_NAME_LENGTH, packet, packet_size);
-
-    int rc = ::sendPacketOut(sock, pkt_with_aux_data, packet_size + MAX_INTF_NAME_LENGTH, dst_udp_port_no);
-
-    close(sock);
-
-    return rc;
+    EgressFrame frame(packet);
+    if (strip_vlan_tag && packet->getLength() >= sizeof(VLANEthernetHeader) &&
+        isPacketVLANTagged(reinterpret_cast<EthernetHeader *>(packet->getData()))) {
+        frame.omit(offsetof(VLANEthernetHeader, vlan_8021q_header), sizeof(VLAN8021QHeader));
+    }
+    return getTransport()->sendPacketOut(this, frame);
 }
 
-extern void layer2FrameRecv(Node *node, Interface *interface, char *packet, uint32_t packet_size);
-
-int Interface::receivePacket(char *packet, uint32_t packet_size)
+int Interface::receivePacket(PacketBuffer *packet)
 {
     /*
         Entry point into data link layer from physical layer
         Ingress journey of the packet starts from here in the TCP/IP stack
     */
-    packet = packetBufferShiftRight(packet, packet_size, MAX_PACKET_BUFFER_SIZE - MAX_INTF_NAME_LENGTH);
+    if (!isFrameWithinMTU(packet->getData(), packet->getLength())) {
+        return -1;
+    }
 
-    layer2FrameRecv(const_cast<Node *>(getNode()), this, packet, packet_size);
+    ingress_handler.load(std::memory_order_relaxed)(att_node, this, packet);
 
     return 0;
 }
 
+void Interface::updateIngressHandler()
+{
+    ingress_handler.store(layer2ResolveIngressHandler(this), std::memory_order_relaxed);
+}
+
 void Interface::setL2Mode(const InterfaceNetworkProperty::L2Mode &mode)
 {
     // when mode is set to undesired value, then we will cast early return.
@@ -136,6 +222,7 @@ void Interface::setL2Mode(const InterfaceNetworkProperty::L2Mode &mode)
     }
 
     const InterfaceNetworkProperty::L2Mode old_l2_mode = intf_network_property.getL2Mode();
+    const uint32_t old_access_vlan_id = old_l2_mode == InterfaceNetworkProperty::L2Mode::ACCESS ? intf_network_property.getVLANID() : 0;
 
     // in all other cases, we accepts new L2 Mode.
     intf_network_property.setL2Mode(mode);
@@ -145,17 +232,23 @@ void Interface::setL2Mode(const InterfaceNetworkProperty::L2Mode &mode)
     // 1. when the node was working as L3 Mode, then unset the IP address.
     if (isL3Mode()) {
         intf_network_property.unsetIPAddress();
-        return;
     }
-
     // 2. when the old l2 setting of the node was TRUNK mode, and the new setting is ACCESS mode, then
     // reset all of the VLAN setting.
-    if (old_l2_mode == InterfaceNetworkProperty::L2Mode::TRUNK &&
-        mode == InterfaceNetworkProperty::L2Mode::ACCESS) {
+    else if (old_l2_mode == InterfaceNetworkProperty::L2Mode::TRUNK &&
+             mode == InterfaceNetworkProperty::L2Mode::ACCESS) {
         intf_network_property.resetVLANSetting();
-        return;
+    }
+    // 3. when the old l2 setting of the node was ACCESS mode, and the new setting is TRUNK mode, then
+    // keep carrying the VLAN of the access port as a trunk member.
+    else if (old_access_vlan_id && mode == InterfaceNetworkProperty::L2Mode::TRUNK) {
+        intf_network_property.addVLANMemberships(old_access_vlan_id);
     }
 
+    updateIngressHandler();
+    if (att_node) {
+        att_node->updateFloodPortSets();
+    }
 }
 
 void Interface::setVLANMemberships(uint32_t vlan_id)
@@ -181,7 +274,37 @@ void Interface::setVLANMemberships(uint32_t vlan_id)
         break;
     }
     }
-    return;
+
+    updateIngressHandler();
+    if (att_node) {
+        att_node->updateFloodPortSets();
+    }
+}
+
+void Interface::setVLANMemberships(uint32_t first_vlan_id, uint32_t last_vlan_id)
+{
+    if (intf_network_property.getL2Mode() != InterfaceNetworkProperty::L2Mode::TRUNK) {
+        std::cout << "Error : Interface " << if_name << " : VLAN ranges can be set only on L2 trunk mode" << std::endl;
+        return;
+    }
+
+    intf_network_property.addVLANMemberships(first_vlan_id, last_vlan_id);
+    if (att_node) {
+        att_node->updateFloodPortSets();
+    }
+}
+
+void Interface::unsetVLANMemberships(uint32_t first_vlan_id, uint32_t last_vlan_id)
+{
+    if (intf_network_property.getL2Mode() != InterfaceNetworkProperty::L2Mode::TRUNK) {
+        std::cout << "Error : Interface " << if_name << " : VLAN ranges can be unset only on L2 trunk mode" << std::endl;
+        return;
+    }
+
+    intf_network_property.removeVLANMemberships(first_vlan_id, last_vlan_id);
+    if (att_node) {
+        att_node->updateFloodPortSets();
+    }
 }
 
 void Interface::dump() const
@@ -206,11 +329,16 @@ void Interface::dump() const
 Node::Node(const std::string &name) :
     node_name(name.substr(0, MAX_NODE_NAME_LENGTH)),
     node_network_property(),
+    is_flood_port_sets_stale(false),
     udp_port_number(0),
-    udp_sock_fd(-1)
+    udp_sock_fd(-1),
+    ring_doorbell_fd(-1),
+    max_frame_size(LinkHeader::MAX_SIZE + VLAN_ETH_HDR_SIZE_EXCL_PAYLOAD + DEFAULT_MTU),
+    egress_batch()
 {
     std::fill(std::begin(intfs), std::end(intfs), nullptr);
     initUDPSocket();
+    initRingDoorbell();
 }
 
 Node::~Node()
@@ -245,11 +373,12 @@ bool Node::hasVacantInterfaceSlot() const
 
 bool Node::trySetInterfaceToSlot(Interface *intf)
 {
-    for (auto &intf_ref : intfs) {
-        if (intf_ref) {
+    for (uint32_t i = 0; i < MAX_INTF_PER_NODE; i++) {
+        if (intfs[i]) {
             continue;
         }
-        intf_ref = intf;
+        intfs[i] = intf;
+        intf->setIfIndex(i);
         return true;
     }
     return false;
@@ -285,9 +414,8 @@ Interface *Node::getNodeInterfaceByName(const std::string &if_name)
     return *result;
 }
 
-Interface *Node::getMatchingSubnetInterface(const std::string &ip_addr)
+Interface *Node::getMatchingSubnetInterface(const IPAddress &input_ip)
 {
-    IPAddress input_ip(ip_addr);
     auto result = std::find_if(
         std::begin(intfs),
         std::end(intfs),
@@ -334,42 +462,173 @@ bool Node::unsetInterfaceIPAddress(const std::string &if_name)
     return true;
 }
 
-void Node::receivePacket(char *packet_with_aux_data, uint32_t packet_size)
+bool Node::setInterfaceMTU(const std::string &if_name, uint32_t mtu)
 {
-    std::string recv_interface_name = "";
-    const uint32_t max_interface_name_length = Interface::getMaxInterfaceNameLength();
-    for (uint32_t i = 0; i < max_interface_name_length; i++) {
-        if (!packet_with_aux_data[i]) {
-            break;
+    Interface *intf = getNodeInterfaceByName(if_name);
+    if (!intf) {
+        return false;
+    }
+    if (!intf->setMTU(mtu)) {
+        return false;
+    }
+
+    // frames of the new MTU arrive at both ends of the link
+    updateMaxFrameSize();
+    if (Interface *peer_intf = intf->getPeerInterface(); peer_intf) {
+        const_cast<Node *>(peer_intf->getNode())->updateMaxFrameSize();
+    }
+    return true;
+}
+
+void Node::updateMaxFrameSize()
+{
+    uint32_t mtu = 0;
+    for (const auto &intf : intfs) {
+        if (!intf) {
+            continue;
+        }
+        mtu = std::max(mtu, intf->getMTU());
+        if (const Interface *peer_intf = intf->getPeerInterface(); peer_intf) {
+            mtu = std::max(mtu, peer_intf->getMTU());
         }
-        recv_interface_name += packet_with_aux_data[i];
     }
-    Interface *recv_intf = getNodeInterfaceByName(recv_interface_name);
 
-    if (!recv_intf) {
-        std::cout << "Error : Packet recvd on unknown interface" << recv_interface_name << " on node " << node_name << std::endl;
+    uint32_t frame_size = LinkHeader::MAX_SIZE + VLAN_ETH_HDR_SIZE_EXCL_PAYLOAD + mtu;
+    if (max_frame_size.exchange(frame_size, std::memory_order_relaxed) == frame_size) {
         return;
     }
+    // io_uring receive buffers belong to the receiver thread. bursts of epoll receive pick up the new size by themselves.
+    runOnReceiverThread([this] {
+        if (IoUringEngine *engine = IoUringEngine::getThreadEngine(); engine) {
+            engine->setMaxFrameSize(udp_sock_fd, getMaxFrameSize());
+        }
+    });
+}
 
-    recv_intf->receivePacket(packet_with_aux_data + max_interface_name_length, packet_size - max_interface_name_length);
+bool Node::setInterfaceStormControl(const std::string &if_name, StormControl::TrafficType type, uint32_t rate)
+{
+    Interface *intf = getNodeInterfaceByName(if_name);
+    if (!intf) {
+        return false;
+    }
+    return intf->getStormControl().setRate(type, rate);
 }
 
-void Node::sendPacketFlood(Interface *exempted_intf, char *packet, uint32_t packet_size)
+void Node::dumpStormControl() const
 {
-    for (auto &intf : intfs) {
+    for (const auto &intf : intfs) {
         if (!intf) {
             continue;
         }
-        if (intf == exempted_intf) {
+        std::cout << "Interface Name : " << intf->getName() << std::endl;
+        intf->getStormControl().dump();
+    }
+}
+
+void Node::receivePacket(char *packet_with_aux_data, uint32_t packet_size)
+{
+    // frames emitted while processing this packet are sent together at the end of the event
+    PacketBuffer *packet = PacketBuffer::allocate(packet_with_aux_data, packet_size);
+    if (!packet) {
+        return;
+    }
+
+    egress_batch.open();
+    deliverPacket(packet);
+    egress_batch.close();
+    layer2PublishSnapshots(this);
+
+    packet->release();
+}
+
+void Node::receivePacketBurst(IngressBurst *burst)
+{
+    egress_batch.open();
+    for (uint32_t i = 0; i < burst->getFrameCount(); i++) {
+        deliverPacket(burst->getFrame(i));
+    }
+    egress_batch.close();
+    layer2PublishSnapshots(this);
+}
+
+void Node::ringDoorbell()
+{
+    uint64_t count = 1;
+    if (write(ring_doorbell_fd, &count, sizeof(count)) < 0) {
+        // counter saturated : the node is going to be woken up anyway
+        return;
+    }
+}
+
+void Node::runOnReceiverThread(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        posted_tasks.push_back(std::move(task));
+    }
+    ringDoorbell();
+}
+
+void Node::processDoorbell()
+{
+    uint64_t count = 0;
+    if (read(ring_doorbell_fd, &count, sizeof(count)) < 0) {
+        // spurious wakeup : tasks and rings are checked below regardless
+    }
+
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        tasks.swap(posted_tasks);
+    }
+
+    egress_batch.open();
+    for (auto &task : tasks) {
+        task();
+    }
+    for (auto &intf : intfs) {
+        if (!intf || !intf->getIngressRing()) {
             continue;
         }
-        intf->sendPacketOut(packet, packet_size);
+        FrameRing *ring = intf->getIngressRing();
+        // the ring belongs to the interface, so frames carry no link header
+        while (PacketBuffer *packet = ring->pop()) {
+            intf->receivePacket(packet);
+            packet->release();
+        }
     }
+    egress_batch.close();
+    layer2PublishSnapshots(this);
 }
 
-extern void l2SwitchSendPacketOut(Node *node, Interface *intf, char *packet, uint32_t packet_size);
+void Node::deliverPacket(PacketBuffer *packet)
+{
+    const char *packet_with_aux_data = packet->getData();
+    const uint32_t packet_size = packet->getLength();
+    const LinkHeader *link_header = reinterpret_cast<const LinkHeader *>(packet_with_aux_data);
+    Interface *recv_intf = nullptr;
+    uint32_t link_header_size = 0;
+
+    if (packet_size >= sizeof(LinkHeader) && link_header->magic == LinkHeader::MAGIC) {
+        recv_intf = getNodeInterfaceByIndex(link_header->ifindex);
+        link_header_size = sizeof(LinkHeader);
+    }
+    else if (packet_size >= LinkHeader::LEGACY_SIZE) {
+        // compatibility mode : frames addressed by the interface name
+        recv_intf = getNodeInterfaceByName(std::string(packet_with_aux_data, strnlen(packet_with_aux_data, LinkHeader::LEGACY_SIZE)));
+        link_header_size = LinkHeader::LEGACY_SIZE;
+    }
+
+    if (!recv_intf) {
+        std::cout << "Error : Packet recvd on unknown interface on node " << node_name << std::endl;
+        return;
+    }
+
+    packet->pullHeader(link_header_size);
+    recv_intf->receivePacket(packet);
+}
 
-void Node::sendPacketFloodToL2Interface(Interface *exempted_intf, char *packet, uint32_t packet_size)
+void Node::sendPacketFlood(Interface *exempted_intf, PacketBuffer *packet)
 {
     for (auto &intf : intfs) {
         if (!intf) {
@@ -378,11 +637,76 @@ void Node::sendPacketFloodToL2Interface(Interface *exempted_intf, char *packet,
         if (intf == exempted_intf) {
             continue;
         }
-        if (intf->getL2Mode() != InterfaceNetworkProperty::L2Mode::ACCESS &&
-            intf->getL2Mode() != InterfaceNetworkProperty::L2Mode::TRUNK) {
+        intf->sendPacketOut(packet);
+    }
+}
+
+void Node::sendPacketFloodToL2Interface(Interface *exempted_intf, PacketBuffer *packet, uint32_t vlan_id)
+{
+    if (vlan_id >= flood_port_sets.size()) {
+        return;
+    }
+
+    const FloodPortSet &flood_port_set = flood_port_sets[vlan_id];
+    uint32_t egress_ports = flood_port_set.egress_ports;
+    if (exempted_intf) {
+        egress_ports &= ~(1u << exempted_intf->getIfIndex());
+    }
+    while (egress_ports) {
+        uint32_t ifindex = __builtin_ctz(egress_ports);
+        egress_ports &= egress_ports - 1;
+        intfs[ifindex]->sendPacketOut(packet, flood_port_set.untagged_ports & (1u << ifindex));
+    }
+}
+
+void Node::updateFloodPortSets()
+{
+    if (is_flood_port_sets_stale.exchange(true, std::memory_order_acq_rel)) {
+        // the posted rebuild has not started yet, and will see this change too
+        return;
+    }
+    runOnReceiverThread([this] {
+        is_flood_port_sets_stale.store(false, std::memory_order_release);
+        rebuildFloodPortSets();
+    });
+}
+
+void Node::rebuildFloodPortSets()
+{
+    bool has_l2_intf = std::any_of(std::begin(intfs), std::end(intfs), [](Interface *intf) {
+        return intf && !intf->isL3Mode() &&
+            (intf->getL2Mode() == InterfaceNetworkProperty::L2Mode::ACCESS ||
+             intf->getL2Mode() == InterfaceNetworkProperty::L2Mode::TRUNK);
+    });
+    flood_port_sets.assign(has_l2_intf ? MAX_VLAN_ID + 1 : 0, FloodPortSet{ 0, 0 });
+
+    for (uint32_t i = 0; i < MAX_INTF_PER_NODE && has_l2_intf; i++) {
+        Interface *intf = intfs[i];
+        if (!intf || intf->isL3Mode()) {
             continue;
         }
-        l2SwitchSendPacketOut(this, intf, packet, packet_size);
+
+        switch (intf->getL2Mode()) {
+        case InterfaceNetworkProperty::L2Mode::ACCESS:
+        {
+            if (uint32_t vlan_id = intf->getVLANID(); vlan_id && vlan_id <= MAX_VLAN_ID) {
+                flood_port_sets[vlan_id].egress_ports |= 1u << i;
+                flood_port_sets[vlan_id].untagged_ports |= 1u << i;
+            }
+            break;
+        }
+        case InterfaceNetworkProperty::L2Mode::TRUNK:
+        {
+            for (uint32_t vlan_id = intf->getNextTrunkVLAN(1); vlan_id; vlan_id = vlan_id < MAX_VLAN_ID ? intf->getNextTrunkVLAN(vlan_id + 1) : 0) {
+                flood_port_sets[vlan_id].egress_ports |= 1u << i;
+            }
+            break;
+        }
+        default:
+        {
+            break;
+        }
+        }
     }
 }
 
@@ -422,12 +746,25 @@ void Node::initUDPSocket()
         std::cout << "Error : socket bind failed for Node " << node_name << std::endl;
         return;
     }
+
+    egress_batch.setSocketFileDescriptor(udp_sock_fd);
+}
+
+void Node::initRingDoorbell()
+{
+    ring_doorbell_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ring_doorbell_fd < 0) {
+        std::cout << "Error : eventfd() failed for Node " << node_name << std::endl;
+        return;
+    }
 }
 
 Link::Link(const std::string &from_if_name, const std::string &to_if_name, uint32_t _cost) :
     intf1(from_if_name),
     intf2(to_if_name),
-    cost(_cost)
+    cost(_cost),
+    ring_to_intf1(nullptr),
+    ring_to_intf2(nullptr)
 {
 }
 
@@ -457,11 +794,39 @@ Link *Link::tryCreate(Node *node1, Node *node2, const std::string &from_if_name,
     link->getToInterface()->setLink(link);
     link->getToInterface()->assignMACAddress();
 
+    link->getFromInterface()->initTransmission();
+    link->getToInterface()->initTransmission();
+
     return link;
 }
 
-Graph::Graph(const std::string &name) :
-    topology_name(name.substr(0, MAX_TOPOLOGY_NAME_LENGTH))
+bool Link::attachFrameRings(uint32_t capacity)
+{
+    if (!intf1.getNode() || !intf2.getNode()) {
+        return false;
+    }
+    if (intf1.getNode()->getRingDoorbellFileDescriptor() < 0 || intf2.getNode()->getRingDoorbellFileDescriptor() < 0) {
+        return false;
+    }
+
+    if (!ring_to_intf1) {
+        ring_to_intf1 = std::make_unique<FrameRing>(capacity);
+        intf1.setIngressRing(ring_to_intf1.get());
+    }
+    if (!ring_to_intf2) {
+        ring_to_intf2 = std::make_unique<FrameRing>(capacity);
+        intf2.setIngressRing(ring_to_intf2.get());
+    }
+    return true;
+}
+
+Graph::Graph(const std::string &name, ITransport::Type transport_type) :
+    topology_name(name.substr(0, MAX_TOPOLOGY_NAME_LENGTH)),
+    rx_burst_size(IngressBurst::DEFAULT_BURST_SIZE),
+    receiver_thread_count(1),
+    transport(ITransport::getTransport(transport_type)),
+    link_header_format(LinkHeader::Format::COMPACT),
+    event_loops()
 {
 }
 
@@ -496,10 +861,50 @@ bool Graph::insertLinkBetweenTwoNodes(Node *node1, Node *node2, const std::strin
     if (!link) {
         return false;
     }
+    link->getFromInterface()->setLinkHeaderFormat(link_header_format);
+    link->getToInterface()->setLinkHeaderFormat(link_header_format);
 
+    return attachTransport(link);
+}
+
+bool Graph::attachTransport(Link *link)
+{
+    if (!transport->attachLink(link)) {
+        std::cout << "Error : transport " << transport->getName() << " is not available on the link" << std::endl;
+        return false;
+    }
+    link->getFromInterface()->setTransport(transport);
+    link->getToInterface()->setTransport(transport);
     return true;
 }
 
+bool Graph::setTransport(ITransport::Type transport_type)
+{
+    // the direct transport runs the peer's ingress on the sending thread, which must own every node
+    if (transport_type == ITransport::Type::DIRECT && getReceiverThreadCount() > 1) {
+        std::cout << "Error : transport direct requires a single receiver thread, but " << getReceiverThreadCount()
+                  << " are running. restart test.out without a receiver thread count to use it" << std::endl;
+        return false;
+    }
+    transport = ITransport::getTransport(transport_type);
+
+    bool result = true;
+    for (const auto &node : nodes) {
+        for (const auto &intf : node->getInterfaces()) {
+            if (!intf) {
+                continue;
+            }
+            Link *link = const_cast<Link *>(intf->getLink());
+            // visit each link once
+            if (link->getFromInterface() != intf) {
+                continue;
+            }
+            result = attachTransport(link) && result;
+        }
+    }
+    return result;
+}
+
 Node *Graph::getNodeByNodeName(const std::string &node_name)
 {
     auto result = std::find_if(std::begin(nodes), std::end(nodes), [&](Node *node) -> bool { return node->getName() == node_name;});
@@ -509,57 +914,159 @@ Node *Graph::getNodeByNodeName(const std::string &node_name)
     return *result;
 }
 
-void Graph::startPacketReceiverThread()
+bool Graph::setReceiverThreadCount(uint32_t thread_count)
 {
-    std::thread t
-    ([this] {
-        fd_set active_sock_fd_set, backup_sock_fd_set;
-
-        int sock_max_fd = 0;
-        int bytes_recvd = 0;
+    // the running threads own their event loops and nodes until the process exits
+    if (isReceiverThreadStarted()) {
+        std::cout << "Error : receiver thread count cannot be changed after the receiver threads have started" << std::endl;
+        return false;
+    }
+    if (transport->getType() == ITransport::Type::DIRECT && thread_count > 1) {
+        std::cout << "Error : transport direct requires a single receiver thread" << std::endl;
+        return false;
+    }
+    receiver_thread_count = std::max(thread_count, 1u);
+    return true;
+}
 
-        int addr_len = sizeof(sockaddr);
+void Graph::startPacketReceiverThread()
+{
+    if (isReceiverThreadStarted()) {
+        std::cout << "Error : receiver threads have already started" << std::endl;
+        return;
+    }
 
-        FD_ZERO(&active_sock_fd_set);
-        FD_ZERO(&backup_sock_fd_set);
+    uint32_t thread_count = std::max(std::min(receiver_thread_count, static_cast<uint32_t>(nodes.size())), 1u);
+    for (uint32_t i = 0; i < thread_count; i++) {
+        event_loops.push_back(std::make_unique<EventLoop>());
+    }
 
-        sockaddr_in sender_addr;
+    std::vector<std::vector<Node *>> shards(event_loops.size());
+    uint32_t shard_index = 0;
+    for (const auto &node : nodes) {
+        shards[shard_index].push_back(node);
+        shard_index = (shard_index + 1) % shards.size();
+    }
 
-        for (const auto &node : nodes) {
-            int sock_fd = node->getUDPSocketFileDescriptor();
-            if (sock_fd < 0) {
-                continue;
+    // the transport may be switched by the CLI while the threads start up
+    const bool use_io_uring = transport->getType() == ITransport::Type::IO_URING;
+    const uint32_t burst_size = rx_burst_size;
+    for (uint32_t i = 0; i < event_loops.size(); i++) {
+        std::thread t
+        ([this, i, use_io_uring, burst_size, shard = std::move(shards[i])] {
+            EventLoop *event_loop = event_loops[i].get();
+            IngressBurst burst(burst_size);
+            // created once a node of the shard may receive jumbo frames
+            std::unique_ptr<IngressBurst> jumbo_burst;
+
+            // node sockets are read by io_uring when the topology starts on the io_uring transport
+            std::unique_ptr<IoUringEngine> engine;
+            if (use_io_uring) {
+                engine = std::make_unique<IoUringEngine>();
+                if (!engine->isReady()) {
+                    std::cout << "Error : io_uring is not available, falling back to epoll receive" << std::endl;
+                    engine.reset();
+                }
+            }
+            if (engine) {
+                engine->bindToThisThread();
+                event_loop->addFileDescriptor(engine->getFileDescriptor(), EPOLLIN, [engine = engine.get()](uint32_t events) {
+                    (void)events;
+                    engine->processCompletions();
+                });
+                event_loop->setPostDispatchHandler([engine = engine.get()] {
+                    engine->submit();
+                });
             }
-            FD_SET(sock_fd, &backup_sock_fd_set);
-            sock_max_fd = std::max(sock_max_fd, sock_fd);
-        }
-
-        while (true) {
-            memcpy(&active_sock_fd_set, &backup_sock_fd_set, sizeof(fd_set));
-            select(sock_max_fd + 1, &active_sock_fd_set, nullptr, nullptr, nullptr);
 
-            for (auto &node : nodes) {
+            auto receiveBursts = [event_loop, burst_size, &burst, &jumbo_burst](Node *node, int sock_fd) {
+                event_loop->addFileDescriptor(sock_fd, EPOLLIN, [node, sock_fd, burst_size, &burst, &jumbo_burst](uint32_t events) {
+                    (void)events;
+                    IngressBurst *node_burst = &burst;
+                    if (node->getMaxFrameSize() > burst.getMaxFrameSize()) {
+                        if (!jumbo_burst) {
+                            jumbo_burst = std::make_unique<IngressBurst>(burst_size, MAX_PACKET_BUFFER_SIZE);
+                        }
+                        node_burst = jumbo_burst.get();
+                    }
+                    if (node_burst->receive(sock_fd) > 0) {
+                        node->receivePacketBurst(node_burst);
+                    }
+                });
+            };
+
+            for (const auto &node : shard) {
                 int sock_fd = node->getUDPSocketFileDescriptor();
                 if (sock_fd < 0) {
                     continue;
                 }
-                if (!FD_ISSET(sock_fd, &active_sock_fd_set)) {
-                    continue;
+                // a socket whose io_uring receive fails is read by recvmmsg bursts instead
+                bool is_receiving = engine && engine->addReceiver(sock_fd, node->getMaxFrameSize(), [node](char *frame, uint32_t frame_size) {
+                    node->receivePacket(frame, frame_size);
+                }, [receiveBursts, node, sock_fd] {
+                    std::cout << "Error : falling back to epoll receive on node " << node->getName() << std::endl;
+                    receiveBursts(node, sock_fd);
+                });
+                if (!is_receiving) {
+                    receiveBursts(node, sock_fd);
                 }
 
-                memset(recv_buffer, 0, MAX_PACKET_BUFFER_SIZE);
-                bytes_recvd = recvfrom(sock_fd, reinterpret_cast<char *>(recv_buffer), MAX_PACKET_BUFFER_SIZE, 0, reinterpret_cast<sockaddr *>(&sender_addr), reinterpret_cast<socklen_t *>(&addr_len));
-                node->receivePacket(recv_buffer, bytes_recvd);
+                if (int doorbell_fd = node->getRingDoorbellFileDescriptor(); doorbell_fd >= 0) {
+                    event_loop->addFileDescriptor(doorbell_fd, EPOLLIN, [node](uint32_t events) {
+                        (void)events;
+                        node->processDoorbell();
+                    });
+                }
             }
-        }
-     });
 
-    t.detach();
+            // L2 tables are aged and published by the thread modifying them
+            if (int aging_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC); aging_timer_fd >= 0) {
+                itimerspec interval = {};
+                interval.it_value.tv_sec = 1;
+                interval.it_interval.tv_sec = 1;
+                timerfd_settime(aging_timer_fd, 0, &interval, nullptr);
+                event_loop->addFileDescriptor(aging_timer_fd, EPOLLIN, [aging_timer_fd, &shard](uint32_t events) {
+                    (void)events;
+                    uint64_t expirations;
+                    if (read(aging_timer_fd, &expirations, sizeof(expirations)) < 0) {
+                        return;
+                    }
+                    for (const auto &node : shard) {
+                        layer2RunPeriodicTasks(node);
+                    }
+                });
+            }
+
+            if (engine) {
+                engine->submit();
+            }
+
+            event_loop->run();
+         });
+
+        t.detach();
+    }
+}
+
+void Graph::setLinkHeaderFormat(LinkHeader::Format format)
+{
+    link_header_format = format;
+    for (const auto &node : nodes) {
+        for (const auto &intf : node->getInterfaces()) {
+            if (!intf) {
+                continue;
+            }
+            intf->setLinkHeaderFormat(format);
+        }
+    }
 }
 
 void Graph::dump() const
 {
-    std::cout << "Topology Name = " << topology_name << std::endl;
+    std::cout
+        << "Topology Name = " << topology_name << ", "
+        << "Transport = " << transport->getName() << ", "
+        << "Link Header = " << LinkHeader::getFormatName(link_header_format) << std::endl;
     for (const auto &node : nodes) {
         node->dump();
     }
@@ -8,17 +8,37 @@
 
 #pragma once
 
+#include <netinet/in.h>
+
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
+#include "comm.hpp"
+#include "event_loop.hpp"
+#include "frame_ring.hpp"
 #include "net.hpp"
+#include "packet_buffer.hpp"
 #include "printer.hpp"
+#include "storm_control.hpp"
+#include "transport.hpp"
 
  // forward declaration
 class Node;
 class Link;
+class Interface;
+
+/**
+ * @brief function processing a frame received on an interface, specialized for the interface's configuration.
+ *
+ */
+using IngressHandler = void (*)(Node *node, Interface *interface, PacketBuffer *packet);
 
 /**
  * @class Interface
@@ -36,7 +56,14 @@ public:
      */
     explicit Interface(const std::string &name);
 
-    static uint32_t getMaxInterfaceNameLength()
+    /**
+     * @brief Destroy the Interface object.
+     *        It also closes the transmit socket.
+     *
+     */
+    ~Interface();
+
+    static constexpr uint32_t getMaxInterfaceNameLength()
     {
         return MAX_INTF_NAME_LENGTH;
     }
@@ -51,6 +78,45 @@ public:
         return if_name;
     }
 
+    /**
+     * @brief sets the index of the interface on its node. frames addressed to the interface carry it in their link header.
+     *
+     * @param ifindex index of the interface slot on the node
+     */
+    void setIfIndex(uint16_t ifindex)
+    {
+        this->ifindex = ifindex;
+    }
+
+    uint16_t getIfIndex() const
+    {
+        return ifindex;
+    }
+
+    /**
+     * @brief sets the format of the link header written on frames sent out of this interface.
+     *        may be changed while frames are being sent, as receivers accept both formats.
+     *
+     * @param format LinkHeader::Format::LEGACY_NAME keeps frames readable by old receivers and captures.
+     */
+    void setLinkHeaderFormat(LinkHeader::Format format)
+    {
+        link_header_format.store(format, std::memory_order_relaxed);
+    }
+
+    LinkHeader::Format getLinkHeaderFormat() const
+    {
+        return link_header_format.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief writes the link header addressing the peer interface.
+     *
+     * @param buffer buffer of at least LinkHeader::MAX_SIZE bytes
+     * @return uint32_t size of the written header. 0 if the link is not created yet.
+     */
+    uint32_t encodeLinkHeader(char *buffer) const;
+
     /**
      * @brief Sets node attached to this interface
      *
@@ -78,6 +144,79 @@ public:
      */
     const Node *getNeighbourNode() const;
 
+    /**
+     * @brief returns the interface which is on the other side of the link
+     *
+     * @return the interface which is on the other side of the link. nullptr if the link is not created yet.
+     */
+    Interface *getPeerInterface() const
+    {
+        return peer_intf;
+    }
+
+    /**
+     * @brief opens the transmit socket and caches the peer interface and its node's UDP address.
+     *        must be called after both endpoints of the link are attached to their nodes.
+     *
+     * @return true if the transmit socket is ready
+     * @return false otherwise
+     */
+    bool initTransmission();
+
+    /**
+     * @brief sets the ring which carries frames destined to this interface over the frame ring transport.
+     *        called by `Link::attachFrameRings` when FrameRingTransport attaches the link. the ring is used only
+     *        while the interface's transport is the frame ring one : other transports leave it alone.
+     *        the node's receiver thread drains it when the doorbell rings.
+     *
+     * @param ring ring owned by the link
+     */
+    void setIngressRing(FrameRing *ring)
+    {
+        ingress_ring.store(ring, std::memory_order_release);
+    }
+
+    FrameRing *getIngressRing() const
+    {
+        return ingress_ring.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief gets the socket used for sending frames over the UDP transport.
+     *
+     * @return int file descriptor. -1 if the transmission is not initialized.
+     */
+    int getTransmitSocketFileDescriptor() const
+    {
+        return tx_sock_fd;
+    }
+
+    /**
+     * @brief gets the UDP address of the peer node.
+     *
+     * @return const sockaddr_in&
+     */
+    const sockaddr_in &getPeerSocketAddress() const
+    {
+        return peer_addr;
+    }
+
+    /**
+     * @brief sets the transport which carries frames sent out of this interface.
+     *        may be called while frames are being sent : the link must be prepared for `transport` beforehand.
+     *
+     * @param transport transport
+     */
+    void setTransport(ITransport *transport)
+    {
+        this->transport.store(transport, std::memory_order_release);
+    }
+
+    ITransport *getTransport() const
+    {
+        return transport.load(std::memory_order_acquire);
+    }
+
     /**
      * @brief sets a link information to this interface
      *
@@ -160,20 +299,25 @@ public:
     /**
      * @brief sends data from this interface to the opponent interface
      *
-     * @param packet data to be sent
-     * @param packet_size size of the data
+     * @param packet frame to be sent. the caller keeps its reference, the frame is not modified.
+     * @param strip_vlan_tag true to leave the 802.1Q tag of the frame out on the wire
      * @return int size of the sent data
      */
-    int sendPacketOut(char *packet, uint32_t packet_size);
+    int sendPacketOut(PacketBuffer *packet, bool strip_vlan_tag = false);
 
     /**
      * @brief receives data from the opponent interface
      *
-     * @param packet data recvd
-     * @param packet_size size of the data
+     * @param packet frame recvd. the caller keeps its reference, the frame may be modified in place.
      * @return int
      */
-    int receivePacket(char *packet, uint32_t packet_size);
+    int receivePacket(PacketBuffer *packet);
+
+    /**
+     * @brief re-selects the ingress handler after the IP address, L2 mode or access VLAN has changed.
+     *
+     */
+    void updateIngressHandler();
 
     const InterfaceNetworkProperty::L2Mode &getL2Mode() const
     {
@@ -184,17 +328,75 @@ public:
 
     void setVLANMemberships(uint32_t vlan_id);
 
+    /**
+     * @brief adds VLANs from `first_vlan_id` to `last_vlan_id` (both inclusive) to a trunk port.
+     *
+     * @param first_vlan_id first VLAN ID of the range
+     * @param last_vlan_id last VLAN ID of the range
+     */
+    void setVLANMemberships(uint32_t first_vlan_id, uint32_t last_vlan_id);
+
+    /**
+     * @brief removes VLANs from `first_vlan_id` to `last_vlan_id` (both inclusive) from a trunk port.
+     *
+     * @param first_vlan_id first VLAN ID of the range
+     * @param last_vlan_id last VLAN ID of the range
+     */
+    void unsetVLANMemberships(uint32_t first_vlan_id, uint32_t last_vlan_id);
+
     bool isVLANMember(uint32_t vlan_id) const
     {
         return intf_network_property.isVLANMember(vlan_id);
     }
 
+    uint32_t getNextTrunkVLAN(uint32_t vlan_id) const
+    {
+        return intf_network_property.getNextTrunkVLAN(vlan_id);
+    }
+
     const uint32_t getVLANID() const
     {
         return intf_network_property.getVLANID();
     }
 
+    uint32_t getMTU() const
+    {
+        return intf_network_property.getMTU();
+    }
+
+    /**
+     * @brief sets the MTU of the interface. frames whose payload exceeds the MTU are dropped on both directions.
+     *
+     * @param mtu MTU in bytes, between MIN_MTU and MAX_MTU
+     * @return true if the MTU is set
+     * @return false if `mtu` is out of range
+     */
+    bool setMTU(uint32_t mtu);
+
+    /**
+     * @brief checks whether the payload of the ethernet frame fits in the MTU of the interface.
+     *
+     * @param packet ethernet frame
+     * @param packet_size size of the frame
+     * @return true if the frame may pass the interface
+     * @return false otherwise
+     */
+    bool isFrameWithinMTU(const char *packet, uint32_t packet_size) const;
+
+    /**
+     * @brief returns the rate limits of flooded frames received on this interface.
+     *
+     * @return StormControl&
+     */
+    StormControl &getStormControl()
+    {
+        return storm_control;
+    }
 
+    const StormControl &getStormControl() const
+    {
+        return storm_control;
+    }
 
     /**
      * @brief outputs a detail of this interface on the standard output.
@@ -204,10 +406,24 @@ public:
 
 private:
     std::string if_name;
+    uint16_t ifindex;
+    std::atomic<LinkHeader::Format> link_header_format;
     InterfaceNetworkProperty intf_network_property;
     Node *att_node;
     Link *link;
 
+    /* transmission properties, resolved once in Link::tryCreate */
+    Interface *peer_intf;
+    int tx_sock_fd;
+    sockaddr_in peer_addr;
+    std::atomic<FrameRing *> ingress_ring;
+    std::atomic<ITransport *> transport;
+
+    // resolved from the configuration, so that frames are dispatched without inspecting it
+    std::atomic<IngressHandler> ingress_handler;
+
+    StormControl storm_control;
+
     static constexpr uint32_t MAX_INTF_NAME_LENGTH = 16;
 };
 
@@ -258,7 +474,8 @@ public:
     bool hasVacantInterfaceSlot() const;
 
     /**
-     * @brief try to add new interface to the interface list
+     * @brief try to add new interface to the interface list.
+     *        the index of the slot is assigned to the interface as its ifindex.
      *
      * @param intf new interface
      * @return true if `intf` is added to the interface list
@@ -276,6 +493,16 @@ public:
      */
     bool tryRemoveInterfaceFromSlot(Interface *intf);
 
+    /**
+     * @brief Get the interface list. vacant slots hold nullptr.
+     *
+     * @return const std::array<Interface *, MAX_INTF_PER_NODE>&
+     */
+    const auto &getInterfaces() const
+    {
+        return intfs;
+    }
+
     /**
      * @brief Get the interface from the interface list by name of the interface
      *
@@ -285,13 +512,29 @@ public:
      */
     Interface *getNodeInterfaceByName(const std::string &if_name);
 
+    /**
+     * @brief Get the interface from the interface list by its ifindex
+     *
+     * @param ifindex index of the interface slot
+     * @return Interface with the index. nullptr if the slot is vacant or `ifindex` is out of range.
+     */
+    Interface *getNodeInterfaceByIndex(uint32_t ifindex)
+    {
+        return ifindex < MAX_INTF_PER_NODE ? intfs[ifindex] : nullptr;
+    }
+
     /**
      * @brief Get the interface from the interface list whose subnet matches with given IP address.
      *
      * @param ip_addr query parameter IP address
      * @return returns an intreface whose subnet matches with the given IP address. Returns nullptr when none of the interface matches.
      */
-    Interface *getMatchingSubnetInterface(const std::string &ip_addr);
+    Interface *getMatchingSubnetInterface(const IPAddress &ip_addr);
+
+    Interface *getMatchingSubnetInterface(const std::string &ip_addr)
+    {
+        return getMatchingSubnetInterface(IPAddress(ip_addr));
+    }
 
     /**
      * @brief Set the Node Loopback Address object.
@@ -321,6 +564,33 @@ public:
      */
     bool unsetInterfaceIPAddress(const std::string &if_name);
 
+    /**
+     * @brief Set the MTU of the interface which is specified by the input parameter.
+     *
+     * @param if_name name of the interface
+     * @param mtu MTU in bytes. receive buffers of this node and of the peer node are resized accordingly.
+     * @return true if setting the MTU succeeds
+     * @return false if the interface `if_name` was not found or `mtu` is out of range
+     */
+    bool setInterfaceMTU(const std::string &if_name, uint32_t mtu);
+
+    /**
+     * @brief Set the storm control rate of the interface which is specified by the input parameter.
+     *
+     * @param if_name interface name
+     * @param type traffic type to be limited
+     * @param rate packets per second. 0 removes the limit.
+     * @return true if setting the rate succeeds
+     * @return false if the interface `if_name` was not found or `rate` is out of range
+     */
+    bool setInterfaceStormControl(const std::string &if_name, StormControl::TrafficType type, uint32_t rate);
+
+    /**
+     * @brief outputs the storm control rates and drop counters of the interfaces on the standard output.
+     *
+     */
+    void dumpStormControl() const;
+
     /**
      * @brief gets UDP port number assigned to the node.
      *
@@ -349,17 +619,118 @@ public:
      */
     void receivePacket(char *packet_with_aux_data, uint32_t packet_size);
 
+    /**
+     * @brief receive all the packets held by `burst` as a single receive event.
+     *        frames emitted while processing the burst are flushed together at the end.
+     *
+     * @param burst frames received from the node's UDP socket
+     */
+    void receivePacketBurst(IngressBurst *burst);
+
+    /**
+     * @brief returns the size of the largest frame the node may receive on its UDP socket, including the link header.
+     *        it follows the largest MTU of the node's interfaces and of their peers. safe to call from any thread.
+     *
+     * @return uint32_t
+     */
+    uint32_t getMaxFrameSize() const
+    {
+        return max_frame_size.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief recomputes the largest frame size after an MTU change on the node or on a peer of the node.
+     *        the receive buffers of the node follow on its receiver thread.
+     *
+     */
+    void updateMaxFrameSize();
+
+    /**
+     * @brief gets the eventfd which becomes readable when frames are queued in the rings of the node's interfaces,
+     *        or when tasks are posted to the node.
+     *
+     * @return int file descriptor. -1 if the eventfd could not be created.
+     */
+    int getRingDoorbellFileDescriptor() const
+    {
+        return ring_doorbell_fd;
+    }
+
+    /**
+     * @brief notifies the node that frames have been queued in the ring of its interface.
+     *
+     */
+    void ringDoorbell();
+
+    /**
+     * @brief runs `task` on the receiver thread of the node, which is the only thread allowed to modify
+     *        the node's tables and to send frames over the direct transport. safe to call from any thread.
+     *        tasks posted before the receiver threads start run once they do.
+     *
+     * @param task task run as a receive event of the node, so frames it sends are batched
+     */
+    void runOnReceiverThread(std::function<void()> task);
+
+    /**
+     * @brief runs the posted tasks and drains the rings of all interfaces as a single receive event.
+     *        called by the receiver thread when the doorbell rings.
+     *
+     */
+    void processDoorbell();
+
     /**
      * @brief send the packet `packet` out of all interfaces of a node, except the interface `exempted_intf`.
      *
      * @param exempted_intf interface to be excluded from sending a data.
-     * @param packet raw data.
-     * @param packet_size size of the data.
+     * @param packet frame. the caller keeps its reference.
+     */
+    void sendPacketFlood(Interface *exempted_intf, PacketBuffer *packet);
+
+    /**
+     * @brief sends the packet `packet` out of all L2 interfaces which are members of `vlan_id`, except `exempted_intf`.
+     *        the frame is shared by all the ports, access ports leave its tag out on the wire.
+     *
+     * @param exempted_intf interface to be excluded from sending a data.
+     * @param packet tagged frame. the caller keeps its reference.
+     * @param vlan_id VLAN of the frame
+     */
+    void sendPacketFloodToL2Interface(Interface *exempted_intf, PacketBuffer *packet, uint32_t vlan_id);
+
+    /**
+     * @brief schedules the egress ports of each VLAN to be recomputed on the receiver thread, which is the only
+     *        thread reading them. called whenever the L2 setting of an interface changes, from any thread.
+     *        successive changes are coalesced into a single rebuild.
+     *
+     */
+    void updateFloodPortSets();
+
+    /**
+     * @brief returns the batch which collects frames sent by this node during a receive event.
+     *
+     * @return EgressBatch*
      */
-    void sendPacketFlood(Interface *exempted_intf, char *packet, uint32_t packet_size);
+    EgressBatch *getEgressBatch()
+    {
+        return &egress_batch;
+    }
 
-    void sendPacketFloodToL2Interface(Interface *exempted_intf, char *packet, uint32_t packet_size);
+    const EgressBatch *getEgressBatch() const
+    {
+        return &egress_batch;
+    }
 
+    /**
+     * @brief sets the maximum number of frames which are sent by a single sendmmsg call.
+     *        the batch is resized by the receiver thread, so this may be called from any thread.
+     *
+     * @param batch_size maximum number of frames per batch. 1 disables batching.
+     */
+    void setEgressBatchSize(uint32_t batch_size)
+    {
+        runOnReceiverThread([this, batch_size] {
+            egress_batch.setBatchSize(batch_size);
+        });
+    }
 
     const ARPTable *getARPTable() const
     {
@@ -378,11 +749,32 @@ public:
     virtual void dump() const override;
 
 private:
+    /**
+     * @brief pulls the link header off the packet and passes the packet to the interface it addresses.
+     *        both the compact and the legacy header formats are accepted.
+     *
+     * @param packet frame starting with the link header
+     */
+    void deliverPacket(PacketBuffer *packet);
+
+    /**
+     * @brief recomputes the egress ports of each VLAN from the L2 setting of the interfaces.
+     *        called by the receiver thread only.
+     *
+     */
+    void rebuildFloodPortSets();
+
     /**
      * @brief sets file descriptor and assigns UDP port number for the node.
      *
      */
     void initUDPSocket();
+
+    /**
+     * @brief creates the eventfd which notifies the node of frames queued in the rings of its interfaces.
+     *
+     */
+    void initRingDoorbell();
     /**
      * @brief generate unique port number for the node.
      *
@@ -393,15 +785,37 @@ private:
 private:
     static constexpr uint32_t MAX_INTF_PER_NODE = 10;
     static constexpr uint32_t MAX_NODE_NAME_LENGTH = 16;
+
+    /**
+     * @struct FloodPortSet
+     * @brief egress ports of a VLAN, as bitmaps of interface slots
+     */
+    struct FloodPortSet {
+        uint32_t egress_ports;   /* ports which are members of the VLAN */
+        uint32_t untagged_ports; /* access ports, which leave the tag out */
+    };
+    static_assert(MAX_INTF_PER_NODE <= 32, "interface slots must fit in a FloodPortSet bitmap");
     inline static uint32_t memoized_udp_port_number = 40000;
 
     std::string node_name;
     NodeNetworkProperty node_network_property;
     // interface list
     std::array<Interface *, MAX_INTF_PER_NODE> intfs;
+    // indexed by VLAN ID. empty while the node has no L2 interface. owned by the receiver thread.
+    std::vector<FloodPortSet> flood_port_sets;
+    // set while a rebuild of flood_port_sets is posted to the receiver thread
+    std::atomic<bool> is_flood_port_sets_stale;
 
     uint32_t udp_port_number;
     int udp_sock_fd;
+    int ring_doorbell_fd;
+    std::atomic<uint32_t> max_frame_size;
+
+    // tasks posted by other threads, run by the receiver thread on the next doorbell
+    std::mutex task_mutex;
+    std::vector<std::function<void()>> posted_tasks;
+
+    EgressBatch egress_batch;
 };
 
 /**
@@ -432,6 +846,16 @@ public:
      */
     static Link *tryCreate(Node *node1, Node *node2, const std::string &from_if_name, const std::string &to_if_name, uint32_t cost);
 
+    /**
+     * @brief creates a ring for each direction which is used by the in-process ring transport.
+     *        rings which are already attached are kept.
+     *
+     * @param capacity number of frames each ring can hold
+     * @return true if both rings are attached
+     * @return false otherwise
+     */
+    bool attachFrameRings(uint32_t capacity);
+
     /**
      * @brief Get the From Interface object
      *
@@ -473,6 +897,8 @@ private:
     Link(const std::string &from_if_name, const std::string &to_if_name, uint32_t _cost);
     Interface intf1, intf2;
     uint32_t cost;
+    // rings carrying frames toward intf1 and intf2 respectively
+    std::unique_ptr<FrameRing> ring_to_intf1, ring_to_intf2;
 };
 
 /**
@@ -486,8 +912,9 @@ public:
      * @brief Construct a new Graph object
      *
      * @param name name of the topology
+     * @param transport_type transport which carries frames over the links of the topology
      */
-    explicit Graph(const std::string &name);
+    explicit Graph(const std::string &name, ITransport::Type transport_type = ITransport::Type::UDP);
 
     /**
      * @brief Destroy the Graph object
@@ -513,6 +940,28 @@ public:
      */
     bool insertLinkBetweenTwoNodes(Node *node1, Node *node2, const std::string &from_if_name, const std::string &to_if_name, uint32_t cost);
 
+    /**
+     * @brief switches the transport of all the links, including links inserted afterwards.
+     *        the direct transport is refused unless the topology runs a single receiver thread.
+     *
+     * @param transport_type transport which carries frames over the links
+     * @return true if all the links are ready for the transport
+     * @return false otherwise
+     */
+    bool setTransport(ITransport::Type transport_type);
+
+    const ITransport *getTransport() const
+    {
+        return transport;
+    }
+
+    /**
+     * @brief sets the link header format of all the interfaces, including interfaces of links inserted afterwards.
+     *
+     * @param format LinkHeader::Format::LEGACY_NAME sends frames addressed by the interface name (compatibility mode)
+     */
+    void setLinkHeaderFormat(LinkHeader::Format format);
+
     /**
      * @brief Get the pointer to the node by name of the node
      *
@@ -522,11 +971,71 @@ public:
     Node *getNodeByNodeName(const std::string &node_name);
 
     /**
-     * @brief starts the packet receiver thread.
+     * @brief starts the packet receiver threads.
+     *        nodes are distributed round-robin over the receiver threads, and
+     *        each thread runs its own event loop over the sockets of its nodes.
+     *        no more threads than nodes are started.
      *
      */
     void startPacketReceiverThread();
 
+    /**
+     * @brief checks whether the packet receiver threads have been started.
+     *
+     * @return true if the threads are running
+     * @return false otherwise
+     */
+    bool isReceiverThreadStarted() const
+    {
+        return !event_loops.empty();
+    }
+
+    /**
+     * @brief sets the number of packet receiver threads.
+     *        refused once the packet receiver threads are running, and above 1 on the direct transport.
+     *
+     * @param thread_count number of receiver threads. at least 1 thread is used.
+     * @return true if the number is set
+     * @return false if the threads are already running or the transport is direct
+     */
+    bool setReceiverThreadCount(uint32_t thread_count);
+
+    /**
+     * @brief returns the number of running receiver threads, or the configured number before they start.
+     *
+     * @return uint32_t
+     */
+    uint32_t getReceiverThreadCount() const
+    {
+        return isReceiverThreadStarted() ? static_cast<uint32_t>(event_loops.size()) : receiver_thread_count;
+    }
+
+    /**
+     * @brief sets the maximum number of frames read from a node socket per wakeup.
+     *        must be called before starting the packet receiver thread.
+     *
+     * @param burst_size maximum number of frames per wakeup. 1 reads a single frame.
+     */
+    void setReceiveBurstSize(uint32_t burst_size)
+    {
+        rx_burst_size = burst_size;
+    }
+
+    /**
+     * @brief returns the event loop driven by a packet receiver thread.
+     *        timer or control descriptors can be registered to it as well as node sockets.
+     *
+     * @param thread_index index of the receiver thread
+     * @return EventLoop*. nullptr if `thread_index` is out of range or the threads are not started yet.
+     */
+    EventLoop *getEventLoop(uint32_t thread_index = 0)
+    {
+        if (thread_index >= event_loops.size()) {
+            return nullptr;
+        }
+        return event_loops[thread_index].get();
+    }
+
     /**
      * @brief outputs a detail of this graph on the standard output
      *
@@ -534,7 +1043,21 @@ public:
     virtual void dump() const override;
 
 private:
+    /**
+     * @brief prepares the link for the current transport and lets its interfaces use it.
+     *
+     * @param link link to be prepared
+     * @return true if the link is ready
+     * @return false otherwise
+     */
+    bool attachTransport(Link *link);
+
     std::string topology_name;
     std::list<Node *> nodes;
+    uint32_t rx_burst_size;
+    uint32_t receiver_thread_count;
+    ITransport *transport;
+    LinkHeader::Format link_header_format;
+    std::vector<std::unique_ptr<EventLoop>> event_loops;
     static constexpr uint32_t MAX_TOPOLOGY_NAME_LENGTH = 32;
 };
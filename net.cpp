@@ -116,19 +116,55 @@ void NodeNetworkProperty::dump() const
         << std::endl;
 }
 
+uint32_t VLANBitmap::findNext(uint32_t vlan_id) const
+{
+    for (uint32_t i = vlan_id / BITS_PER_WORD; i < WORD_COUNT && vlan_id <= MAX_VLAN_ID; i++) {
+        uint64_t word = words[i];
+        if (i == vlan_id / BITS_PER_WORD) {
+            word &= ~0ull << (vlan_id % BITS_PER_WORD);
+        }
+        if (word) {
+            return i * BITS_PER_WORD + __builtin_ctzll(word);
+        }
+    }
+    return 0;
+}
+
+void VLANBitmap::updateRange(uint32_t first_vlan_id, uint32_t last_vlan_id, bool is_member)
+{
+    last_vlan_id = std::min(last_vlan_id, static_cast<uint32_t>(MAX_VLAN_ID));
+    if (first_vlan_id > last_vlan_id) {
+        return;
+    }
+
+    for (uint32_t i = first_vlan_id / BITS_PER_WORD; i <= last_vlan_id / BITS_PER_WORD; i++) {
+        uint64_t mask = ~0ull;
+        if (i == first_vlan_id / BITS_PER_WORD) {
+            mask &= ~0ull << (first_vlan_id % BITS_PER_WORD);
+        }
+        if (i == last_vlan_id / BITS_PER_WORD) {
+            mask &= ~0ull >> (BITS_PER_WORD - 1 - last_vlan_id % BITS_PER_WORD);
+        }
+        words[i] = is_member ? words[i] | mask : words[i] & ~mask;
+    }
+}
+
 InterfaceNetworkProperty::InterfaceNetworkProperty() :
     mac_addr(),
     l2mode(L2Mode::L2_MODE_UNKOWN),
+    access_vlan_id(0),
+    trunk_vlans(),
+    mtu(DEFAULT_MTU),
     is_ip_addr_configured(false),
     ip_addr("0.0.0.0"),
     mask(0)
 {
-    std::fill(std::begin(vlans), std::end(vlans), 0);
 }
 
 void InterfaceNetworkProperty::resetVLANSetting()
 {
-    std::fill(std::begin(vlans), std::end(vlans), 0);
+    access_vlan_id = 0;
+    trunk_vlans.clear();
 }
 
 bool InterfaceNetworkProperty::isVLANMember(uint32_t vlan_id) const
@@ -138,49 +174,34 @@ bool InterfaceNetworkProperty::isVLANMember(uint32_t vlan_id) const
         return false;
     }
 
-    auto result = std::find_if(
-        std::begin(vlans),
-        std::end(vlans),
-        [&](const uint32_t &vlan_member_id) {
-            return vlan_id == vlan_member_id;
-        }
-    );
-    return result != std::end(vlans);
-}
-
-bool InterfaceNetworkProperty::isVLANOccupied() const
-{
-    auto result = std::find_if(
-        std::begin(vlans),
-        std::end(vlans),
-        [](const uint32_t &vlan_member_id) {
-            return vlan_member_id == 0;
-        }
-    );
-    return result != std::end(vlans);
+    if (l2mode == L2Mode::ACCESS) {
+        return vlan_id == access_vlan_id;
+    }
+    return trunk_vlans.test(vlan_id);
 }
 
 void InterfaceNetworkProperty::updateVLANMemberShips(uint32_t vlan_id)
 {
-    *(std::begin(vlans)) = vlan_id;
-}
-
-void InterfaceNetworkProperty::addVLANMemberships(uint32_t vlan_id)
-{
-    if (isVLANMember(vlan_id)) {
+    if (vlan_id > MAX_VLAN_ID) {
+        std::cout << "Error : VLAN ID " << vlan_id << " is out of range" << std::endl;
         return;
     }
+    access_vlan_id = vlan_id;
+}
 
-    for (auto &vlan_member : vlans) {
-        if (vlan_member != 0) {
-            continue;
-        }
-        vlan_member = vlan_id;
+void InterfaceNetworkProperty::addVLANMemberships(uint32_t first_vlan_id, uint32_t last_vlan_id)
+{
+    // 0 is invalid for VLAN ID.
+    if (first_vlan_id == 0 || first_vlan_id > last_vlan_id || last_vlan_id > MAX_VLAN_ID) {
+        std::cout << "Error : cannot enroll VLAN IDs " << first_vlan_id << "-" << last_vlan_id << " as VLAN members : must be between 1 and " << MAX_VLAN_ID << std::endl;
         return;
     }
+    trunk_vlans.setRange(first_vlan_id, last_vlan_id);
+}
 
-    std::cout << "Error : cannot enroll id " << vlan_id << " as a VLAN member : memberships already occupied" << std::endl;
-    return;
+void InterfaceNetworkProperty::removeVLANMemberships(uint32_t first_vlan_id, uint32_t last_vlan_id)
+{
+    trunk_vlans.resetRange(first_vlan_id, last_vlan_id);
 }
 
 const uint32_t InterfaceNetworkProperty::getVLANID() const
@@ -189,7 +210,7 @@ const uint32_t InterfaceNetworkProperty::getVLANID() const
         std::cout << "Error : " << __FUNCTION__ << " is not supposed to be called on L2 Mode " << getL2ModeStr() << std::endl;
         assert(false);
     }
-    return vlans.front();
+    return access_vlan_id;
 }
 
 void InterfaceNetworkProperty::dump() const
@@ -204,22 +225,32 @@ void InterfaceNetworkProperty::dump() const
         << "  "
         << "L2 Mode : "
         << getL2ModeStr()
+        << "  "
+        << "MTU : "
+        << mtu
         << std::endl;
 
-    if (l2mode == L2Mode::ACCESS || l2mode == L2Mode::TRUNK) {
+    if (l2mode == L2Mode::ACCESS) {
         std::cout << "  VLAN ID(s) :" << std::endl;
-        for (const auto &vlan_id : vlans) {
-            if (vlan_id == 0) {
-                continue;
+        if (access_vlan_id) {
+            std::cout << "   * " << access_vlan_id << std::endl;
+        }
+    }
+    else if (l2mode == L2Mode::TRUNK) {
+        // consecutive VLAN IDs are printed as a range
+        std::cout << "  VLAN ID(s) :" << std::endl;
+        for (uint32_t first = trunk_vlans.findNext(1); first; ) {
+            uint32_t last = first;
+            while (last < MAX_VLAN_ID && trunk_vlans.test(last + 1)) {
+                last++;
+            }
+            if (first == last) {
+                std::cout << "   * " << first << std::endl;
             }
-            std::cout << "   * " << vlan_id << std::endl;
+            else {
+                std::cout << "   * " << first << "-" << last << std::endl;
+            }
+            first = last < MAX_VLAN_ID ? trunk_vlans.findNext(last + 1) : 0;
         }
     }
 }
-
-char *packetBufferShiftRight(char *packet, uint32_t packet_size, uint32_t total_buffer_size)
-{
-    uint32_t head_position = total_buffer_size - packet_size;
-    memmove(packet + head_position, packet, packet_size);
-    return packet + head_position;
-}
@@ -8,12 +8,19 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <cstring>
 #include <string>
 
 #include "printer.hpp"
 
+#define DEFAULT_MTU     1500
+#define MIN_MTU         68
+#define MAX_MTU         9000    /* jumbo frame */
+
+#define MAX_VLAN_ID     4095    /* VLAN IDs are 12 bits long */
+
  // forward declaration
 class ARPTable;
 class MACTable;
@@ -111,7 +118,7 @@ public:
     {
         uint64_t result = 0;
         for (const auto &byte : mac) {
-            result = (result << 8) | byte;
+            result = (result << 8) | static_cast<uint8_t>(byte);
         }
         return result;
     }
@@ -128,6 +135,17 @@ public:
         return getBitRepresentation() == rhs.getBitRepresentation();
     }
 
+    /**
+     * @brief checks whether the address is a group address, including the broadcast address.
+     *
+     * @return true if the I/G bit of the first octet is set
+     * @return false otherwise
+     */
+    bool isMulticast() const
+    {
+        return mac[0] & 0x01;
+    }
+
     /**
      * @brief broadcast MAC address (FF:FF:FF:FF:FF:FF).
      *
@@ -202,6 +220,67 @@ private:
     IPAddress loopback_addr;
 };
 
+/**
+ * @class VLANBitmap
+ * @brief set of VLAN IDs stored as a 4096-bit bitmap.
+ *        Membership tests are O(1), range updates touch one 64-bit word per 64 VLANs.
+ */
+class VLANBitmap {
+public:
+    VLANBitmap()
+    {
+        clear();
+    }
+
+    bool test(uint32_t vlan_id) const
+    {
+        return vlan_id <= MAX_VLAN_ID && ((words[vlan_id / BITS_PER_WORD] >> (vlan_id % BITS_PER_WORD)) & 1);
+    }
+
+    /**
+     * @brief adds VLAN IDs from `first_vlan_id` to `last_vlan_id`, both inclusive.
+     *
+     * @param first_vlan_id first VLAN ID of the range
+     * @param last_vlan_id last VLAN ID of the range, up to MAX_VLAN_ID
+     */
+    void setRange(uint32_t first_vlan_id, uint32_t last_vlan_id)
+    {
+        updateRange(first_vlan_id, last_vlan_id, true);
+    }
+
+    /**
+     * @brief removes VLAN IDs from `first_vlan_id` to `last_vlan_id`, both inclusive.
+     *
+     * @param first_vlan_id first VLAN ID of the range
+     * @param last_vlan_id last VLAN ID of the range, up to MAX_VLAN_ID
+     */
+    void resetRange(uint32_t first_vlan_id, uint32_t last_vlan_id)
+    {
+        updateRange(first_vlan_id, last_vlan_id, false);
+    }
+
+    void clear()
+    {
+        words.fill(0);
+    }
+
+    /**
+     * @brief returns the smallest VLAN ID in the set which is not less than `vlan_id`.
+     *
+     * @param vlan_id VLAN ID to start searching from
+     * @return uint32_t VLAN ID. 0 if there is none.
+     */
+    uint32_t findNext(uint32_t vlan_id) const;
+
+private:
+    static constexpr uint32_t BITS_PER_WORD = 64;
+    static constexpr uint32_t WORD_COUNT = (MAX_VLAN_ID + 1) / BITS_PER_WORD;
+
+    void updateRange(uint32_t first_vlan_id, uint32_t last_vlan_id, bool is_member);
+
+    std::array<uint64_t, WORD_COUNT> words;
+};
+
 /**
  * @class InterfaceNetworkProperty
  * @brief stores network property used by interfaces.
@@ -315,16 +394,72 @@ public:
 
     void resetVLANSetting();
 
+    /**
+     * @brief checks whether the interface carries `vlan_id`.
+     *        access ports carry their native VLAN, trunk ports carry the VLANs of their membership bitmap.
+     *
+     * @param vlan_id VLAN ID
+     * @return true if `vlan_id` is carried by the interface
+     * @return false otherwise
+     */
     bool isVLANMember(uint32_t vlan_id) const;
 
-    bool isVLANOccupied() const;
-
+    /**
+     * @brief sets the native VLAN of an access port
+     *
+     * @param vlan_id VLAN ID
+     */
     void updateVLANMemberShips(uint32_t vlan_id);
 
-    void addVLANMemberships(uint32_t vlan_id);
+    /**
+     * @brief adds VLANs from `first_vlan_id` to `last_vlan_id` (both inclusive) to the membership of a trunk port.
+     *
+     * @param first_vlan_id first VLAN ID of the range
+     * @param last_vlan_id last VLAN ID of the range
+     */
+    void addVLANMemberships(uint32_t first_vlan_id, uint32_t last_vlan_id);
+
+    void addVLANMemberships(uint32_t vlan_id)
+    {
+        addVLANMemberships(vlan_id, vlan_id);
+    }
+
+    /**
+     * @brief removes VLANs from `first_vlan_id` to `last_vlan_id` (both inclusive) from the membership of a trunk port.
+     *
+     * @param first_vlan_id first VLAN ID of the range
+     * @param last_vlan_id last VLAN ID of the range
+     */
+    void removeVLANMemberships(uint32_t first_vlan_id, uint32_t last_vlan_id);
+
+    /**
+     * @brief returns the smallest VLAN carried by a trunk port which is not less than `vlan_id`.
+     *
+     * @param vlan_id VLAN ID to start searching from
+     * @return uint32_t VLAN ID. 0 if there is none.
+     */
+    uint32_t getNextTrunkVLAN(uint32_t vlan_id) const
+    {
+        return trunk_vlans.findNext(vlan_id);
+    }
 
     const uint32_t getVLANID() const;
 
+    /**
+     * @brief gets the largest payload an ethernet frame on the interface can carry
+     *
+     * @return uint32_t
+     */
+    uint32_t getMTU() const
+    {
+        return mtu;
+    }
+
+    void setMTU(uint32_t mtu)
+    {
+        this->mtu = mtu;
+    }
+
     /**
      * @brief outputs a detail of this interface property on the standard output
      *
@@ -339,10 +474,11 @@ private:
     };
 
     /* L2 properties */
-    inline static constexpr uint32_t MAX_VLAN_MEMBERSHIP = 10;
     MACAddress mac_addr; // hard burnt in interface NIC
     L2Mode l2mode;
-    std::array<uint16_t, MAX_VLAN_MEMBERSHIP> vlans;
+    uint32_t access_vlan_id; /* native VLAN of an access port */
+    VLANBitmap trunk_vlans;  /* VLANs carried by a trunk port */
+    uint32_t mtu;
 
     /* L3 properties */
     bool is_ip_addr_configured; /* set to true if IP address is configured
@@ -350,5 +486,3 @@ private:
     IPAddress ip_addr;
     char mask;
 };
-
-char *packetBufferShiftRight(char *packet, uint32_t packet_size, uint32_t total_buffer_size);
@@ -60,7 +60,41 @@ int arp_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
     case CMDCODE_RUN_RESOLVE_ARP:
     {
         Node *node = topo->getNodeByNodeName(node_name);
-        sendARPBroadcastRequest(node, nullptr, ip_address);
+        // resolved by the receiver thread, which owns the node's tables
+        node->runOnReceiverThread([node, ip_addr = IPAddress(ip_address)] {
+            layer2ResolveARP(node, ip_addr);
+        });
+        break;
+    }
+    }
+    return 0;
+}
+
+int ping_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
+{
+    int cmd_code = EXTRACT_CMD_CODE(tlv_buf);
+
+    tlv_struct_t *tlv = NULL;
+    std::string node_name, ip_address;
+
+    TLV_LOOP_BEGIN(tlv_buf, tlv)
+    {
+        if (std::string(tlv->leaf_id) == "node-name") {
+            node_name = tlv->value;
+        }
+        if (std::string(tlv->leaf_id) == "ip-address") {
+            ip_address = tlv->value;
+        }
+    } TLV_LOOP_END;
+
+    switch (cmd_code) {
+    case CMDCODE_RUN_PING:
+    {
+        Node *node = topo->getNodeByNodeName(node_name);
+        // sent by the receiver thread, which owns the node's ARP table
+        node->runOnReceiverThread([node, ip_addr = IPAddress(ip_address)] {
+            layer2SendPing(node, ip_addr);
+        });
         break;
     }
     }
@@ -116,6 +150,234 @@ int show_mac_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disa
     return 0;
 }
 
+int show_egress_batch_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
+{
+    int cmd_code = EXTRACT_CMD_CODE(tlv_buf);
+
+    tlv_struct_t *tlv = NULL;
+    std::string node_name;
+
+    TLV_LOOP_BEGIN(tlv_buf, tlv)
+    {
+        if (std::string(tlv->leaf_id) == "node-name") {
+            node_name = tlv->value;
+        }
+    } TLV_LOOP_END;
+
+    switch (cmd_code) {
+    case CMDCODE_SHOW_EGRESS_BATCH:
+    {
+        Node *node = topo->getNodeByNodeName(node_name);
+        node->getEgressBatch()->dump();
+        break;
+    }
+    }
+    return 0;
+}
+
+int show_storm_control_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
+{
+    int cmd_code = EXTRACT_CMD_CODE(tlv_buf);
+
+    tlv_struct_t *tlv = NULL;
+    std::string node_name;
+
+    TLV_LOOP_BEGIN(tlv_buf, tlv)
+    {
+        if (std::string(tlv->leaf_id) == "node-name") {
+            node_name = tlv->value;
+        }
+    } TLV_LOOP_END;
+
+    switch (cmd_code) {
+    case CMDCODE_SHOW_STORM_CONTROL:
+    {
+        Node *node = topo->getNodeByNodeName(node_name);
+        node->dumpStormControl();
+        break;
+    }
+    }
+    return 0;
+}
+
+/* Transport Commands */
+int transport_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
+{
+    int cmd_code = EXTRACT_CMD_CODE(tlv_buf);
+
+    tlv_struct_t *tlv = NULL;
+    std::string transport_name;
+
+    TLV_LOOP_BEGIN(tlv_buf, tlv)
+    {
+        if (std::string(tlv->leaf_id) == "transport-name") {
+            transport_name = tlv->value;
+        }
+    } TLV_LOOP_END;
+
+    switch (cmd_code) {
+    case CMDCODE_CONFIG_TRANSPORT:
+    {
+        ITransport::Type transport_type;
+        if (enable_or_disable == CONFIG_DISABLE) {
+            transport_type = ITransport::Type::UDP;
+        }
+        else if (!ITransport::tryParseType(transport_name, &transport_type)) {
+            break;
+        }
+        topo->setTransport(transport_type);
+        break;
+    }
+    }
+    return 0;
+}
+
+int link_header_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
+{
+    int cmd_code = EXTRACT_CMD_CODE(tlv_buf);
+
+    tlv_struct_t *tlv = NULL;
+    std::string format_name;
+
+    TLV_LOOP_BEGIN(tlv_buf, tlv)
+    {
+        if (std::string(tlv->leaf_id) == "format") {
+            format_name = tlv->value;
+        }
+    } TLV_LOOP_END;
+
+    switch (cmd_code) {
+    case CMDCODE_CONFIG_LINK_HEADER:
+    {
+        LinkHeader::Format format;
+        if (enable_or_disable == CONFIG_DISABLE) {
+            format = LinkHeader::Format::COMPACT;
+        }
+        else if (!LinkHeader::tryParseFormat(format_name, &format)) {
+            break;
+        }
+        topo->setLinkHeaderFormat(format);
+        break;
+    }
+    }
+    return 0;
+}
+
+/* Node Commands */
+int egress_batch_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
+{
+    int cmd_code = EXTRACT_CMD_CODE(tlv_buf);
+
+    tlv_struct_t *tlv = NULL;
+    std::string node_name;
+    uint32_t batch_size = EgressBatch::DEFAULT_BATCH_SIZE;
+
+    TLV_LOOP_BEGIN(tlv_buf, tlv)
+    {
+        if (std::string(tlv->leaf_id) == "node-name") {
+            node_name = tlv->value;
+        }
+        if (std::string(tlv->leaf_id) == "batch-size") {
+            batch_size = std::stoul(tlv->value);
+        }
+    } TLV_LOOP_END;
+
+    switch (cmd_code) {
+    case CMDCODE_CONFIG_EGRESS_BATCH:
+    {
+        Node *node = topo->getNodeByNodeName(node_name);
+        if (enable_or_disable == CONFIG_DISABLE) {
+            batch_size = EgressBatch::DEFAULT_BATCH_SIZE;
+        }
+        node->setEgressBatchSize(batch_size);
+        break;
+    }
+    }
+    return 0;
+}
+
+/* Interface Commands */
+int intf_mtu_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
+{
+    int cmd_code = EXTRACT_CMD_CODE(tlv_buf);
+
+    tlv_struct_t *tlv = NULL;
+    std::string node_name, if_name;
+    uint32_t mtu = DEFAULT_MTU;
+
+    TLV_LOOP_BEGIN(tlv_buf, tlv)
+    {
+        if (std::string(tlv->leaf_id) == "node-name") {
+            node_name = tlv->value;
+        }
+        if (std::string(tlv->leaf_id) == "if-name") {
+            if_name = tlv->value;
+        }
+        if (std::string(tlv->leaf_id) == "mtu") {
+            mtu = std::stoul(tlv->value);
+        }
+    } TLV_LOOP_END;
+
+    switch (cmd_code) {
+    case CMDCODE_CONFIG_INTF_MTU:
+    {
+        Node *node = topo->getNodeByNodeName(node_name);
+        if (enable_or_disable == CONFIG_DISABLE) {
+            mtu = DEFAULT_MTU;
+        }
+        if (!node->setInterfaceMTU(if_name, mtu)) {
+            std::cout << getColoredString("Error : MTU was not set on interface " + if_name, "Red") << std::endl;
+        }
+        break;
+    }
+    }
+    return 0;
+}
+
+int intf_storm_control_handler(param_t *param, ser_buff_t *tlv_buf, op_mode enable_or_disable)
+{
+    int cmd_code = EXTRACT_CMD_CODE(tlv_buf);
+
+    tlv_struct_t *tlv = NULL;
+    std::string node_name, if_name, traffic_type_name;
+    uint32_t rate = 0;
+
+    TLV_LOOP_BEGIN(tlv_buf, tlv)
+    {
+        if (std::string(tlv->leaf_id) == "node-name") {
+            node_name = tlv->value;
+        }
+        if (std::string(tlv->leaf_id) == "if-name") {
+            if_name = tlv->value;
+        }
+        if (std::string(tlv->leaf_id) == "traffic-type") {
+            traffic_type_name = tlv->value;
+        }
+        if (std::string(tlv->leaf_id) == "rate") {
+            rate = std::stoul(tlv->value);
+        }
+    } TLV_LOOP_END;
+
+    switch (cmd_code) {
+    case CMDCODE_CONFIG_INTF_STORM_CONTROL:
+    {
+        Node *node = topo->getNodeByNodeName(node_name);
+        StormControl::TrafficType traffic_type;
+        if (!StormControl::tryParseTrafficType(traffic_type_name, &traffic_type)) {
+            break;
+        }
+        if (enable_or_disable == CONFIG_DISABLE) {
+            rate = 0;
+        }
+        if (!node->setInterfaceStormControl(if_name, traffic_type, rate)) {
+            std::cout << getColoredString("Error : storm control was not set on interface " + if_name, "Red") << std::endl;
+        }
+        break;
+    }
+    }
+    return 0;
+}
+
 int validate_node_name(char *value)
 {
     if (!topo->getNodeByNodeName(value)) {
@@ -135,6 +397,67 @@ int validate_ipv4_address(char *value)
     return VALIDATION_SUCCESS;
 }
 
+int validate_mtu(char *value)
+{
+    std::cmatch m;
+    if (!std::regex_search(value, m, std::regex("^[0-9]{1,5}$"))) {
+        std::cout << getColoredString("Error : MTU must be a number.", "Red") << std::endl;
+        return VALIDATION_FAILED;
+    }
+    return VALIDATION_SUCCESS;
+}
+
+int validate_traffic_type(char *value)
+{
+    StormControl::TrafficType traffic_type;
+    if (!StormControl::tryParseTrafficType(value, &traffic_type)) {
+        std::cout << getColoredString("Error : unknown traffic type. (broadcast|multicast|unknown-unicast)", "Red") << std::endl;
+        return VALIDATION_FAILED;
+    }
+    return VALIDATION_SUCCESS;
+}
+
+int validate_storm_control_rate(char *value)
+{
+    std::cmatch m;
+    if (!std::regex_search(value, m, std::regex("^[0-9]{1,8}$"))) {
+        std::cout << getColoredString("Error : rate must be a number of packets per second.", "Red") << std::endl;
+        return VALIDATION_FAILED;
+    }
+    return VALIDATION_SUCCESS;
+}
+
+int validate_egress_batch_size(char *value)
+{
+    std::cmatch m;
+    if (!std::regex_search(value, m, std::regex("^[0-9]{1,4}$"))
+        || std::stoul(value) < 1 || std::stoul(value) > EgressBatch::MAX_BATCH_SIZE) {
+        std::cout << getColoredString("Error : batch size must be a number from 1 to " + std::to_string(EgressBatch::MAX_BATCH_SIZE) + ".", "Red") << std::endl;
+        return VALIDATION_FAILED;
+    }
+    return VALIDATION_SUCCESS;
+}
+
+int validate_transport_name(char *value)
+{
+    ITransport::Type transport_type;
+    if (!ITransport::tryParseType(value, &transport_type)) {
+        std::cout << getColoredString("Error : unknown transport. (udp|ring|direct|io_uring)", "Red") << std::endl;
+        return VALIDATION_FAILED;
+    }
+    return VALIDATION_SUCCESS;
+}
+
+int validate_link_header_format(char *value)
+{
+    LinkHeader::Format format;
+    if (!LinkHeader::tryParseFormat(value, &format)) {
+        std::cout << getColoredString("Error : unknown link header format. (compact|legacy)", "Red") << std::endl;
+        return VALIDATION_FAILED;
+    }
+    return VALIDATION_SUCCESS;
+}
+
 void nw_init_cli()
 {
     init_libcli();
@@ -228,6 +551,38 @@ void nw_init_cli()
                 libcli_register_param(&node_name, &mac);
                 set_param_cmd_code(&mac, CMDCODE_SHOW_MAC);
             }
+
+            {
+                static param_t egress_batch;
+                init_param(
+                    &egress_batch,
+                    CMD,
+                    "egress-batch",
+                    show_egress_batch_handler,
+                    0,
+                    INVALID,
+                    0,
+                    "Help : egress-batch"
+                );
+                libcli_register_param(&node_name, &egress_batch);
+                set_param_cmd_code(&egress_batch, CMDCODE_SHOW_EGRESS_BATCH);
+            }
+
+            {
+                static param_t storm_control;
+                init_param(
+                    &storm_control,
+                    CMD,
+                    "storm-control",
+                    show_storm_control_handler,
+                    0,
+                    INVALID,
+                    0,
+                    "Help : storm-control"
+                );
+                libcli_register_param(&node_name, &storm_control);
+                set_param_cmd_code(&storm_control, CMDCODE_SHOW_STORM_CONTROL);
+            }
         }
     }
 
@@ -288,9 +643,261 @@ void nw_init_cli()
                     set_param_cmd_code(&ip_address, CMDCODE_RUN_RESOLVE_ARP);
                 }
             }
+
+            {
+                static param_t ping;
+                init_param(
+                    &ping,
+                    CMD,
+                    "ping",
+                    0,
+                    0,
+                    INVALID,
+                    0,
+                    "Help : ping"
+                );
+                libcli_register_param(&node_name, &ping);
+                {
+                    static param_t ip_address;
+                    init_param(
+                        &ip_address,
+                        LEAF,
+                        0,
+                        ping_handler,
+                        validate_ipv4_address,
+                        IPV4,
+                        "ip-address",
+                        "Help : ip-address"
+                    );
+                    libcli_register_param(&ping, &ip_address);
+                    set_param_cmd_code(&ip_address, CMDCODE_RUN_PING);
+                }
+            }
+        }
+    }
+
+    {
+        /* config transport <transport-name> */
+        static param_t transport;
+        init_param(
+            &transport,
+            CMD,
+            "transport",
+            0,
+            0,
+            INVALID,
+            0,
+            "Help : transport"
+        );
+        libcli_register_param(config, &transport);
+        {
+            static param_t transport_name;
+            init_param(
+                &transport_name,
+                LEAF,
+                0,
+                transport_handler,
+                validate_transport_name,
+                STRING,
+                "transport-name",
+                "Help : udp|ring|direct|io_uring"
+            );
+            libcli_register_param(&transport, &transport_name);
+            set_param_cmd_code(&transport_name, CMDCODE_CONFIG_TRANSPORT);
         }
     }
 
+    {
+        /* config link-header <format> */
+        static param_t link_header;
+        init_param(
+            &link_header,
+            CMD,
+            "link-header",
+            0,
+            0,
+            INVALID,
+            0,
+            "Help : link-header"
+        );
+        libcli_register_param(config, &link_header);
+        {
+            static param_t format;
+            init_param(
+                &format,
+                LEAF,
+                0,
+                link_header_handler,
+                validate_link_header_format,
+                STRING,
+                "format",
+                "Help : compact|legacy"
+            );
+            libcli_register_param(&link_header, &format);
+            set_param_cmd_code(&format, CMDCODE_CONFIG_LINK_HEADER);
+        }
+    }
+
+    {
+        /* config node <node-name> egress-batch <batch-size> */
+        /* config node <node-name> interface <if-name> mtu <mtu> */
+        /* config node <node-name> interface <if-name> storm-control <traffic-type> <rate> */
+        static param_t node;
+        init_param(
+            &node,
+            CMD,
+            "node",
+            0,
+            0,
+            INVALID,
+            0,
+            "Help : Node"
+        );
+        libcli_register_param(config, &node);
+        {
+            static param_t node_name;
+            init_param(
+                &node_name,
+                LEAF,
+                0,
+                0,
+                validate_node_name,
+                STRING,
+                "node-name",
+                "Help : Node name"
+            );
+            libcli_register_param(&node, &node_name);
+            {
+                static param_t egress_batch;
+                init_param(
+                    &egress_batch,
+                    CMD,
+                    "egress-batch",
+                    0,
+                    0,
+                    INVALID,
+                    0,
+                    "Help : egress-batch"
+                );
+                libcli_register_param(&node_name, &egress_batch);
+                {
+                    static param_t batch_size;
+                    init_param(
+                        &batch_size,
+                        LEAF,
+                        0,
+                        egress_batch_handler,
+                        validate_egress_batch_size,
+                        INT,
+                        "batch-size",
+                        "Help : frames per sendmmsg call, 1 disables batching"
+                    );
+                    libcli_register_param(&egress_batch, &batch_size);
+                    set_param_cmd_code(&batch_size, CMDCODE_CONFIG_EGRESS_BATCH);
+                }
+            }
+            {
+                static param_t interface;
+                init_param(
+                    &interface,
+                    CMD,
+                    "interface",
+                    0,
+                    0,
+                    INVALID,
+                    0,
+                    "Help : interface"
+                );
+                libcli_register_param(&node_name, &interface);
+                {
+                    static param_t if_name;
+                    init_param(
+                        &if_name,
+                        LEAF,
+                        0,
+                        0,
+                        0,
+                        STRING,
+                        "if-name",
+                        "Help : Interface name"
+                    );
+                    libcli_register_param(&interface, &if_name);
+                    {
+                        static param_t mtu;
+                        init_param(
+                            &mtu,
+                            CMD,
+                            "mtu",
+                            0,
+                            0,
+                            INVALID,
+                            0,
+                            "Help : mtu"
+                        );
+                        libcli_register_param(&if_name, &mtu);
+                        {
+                            static param_t mtu_value;
+                            init_param(
+                                &mtu_value,
+                                LEAF,
+                                0,
+                                intf_mtu_handler,
+                                validate_mtu,
+                                INT,
+                                "mtu",
+                                "Help : MTU in bytes (68 - 9000)"
+                            );
+                            libcli_register_param(&mtu, &mtu_value);
+                            set_param_cmd_code(&mtu_value, CMDCODE_CONFIG_INTF_MTU);
+                        }
+                    }
+                    {
+                        static param_t storm_control;
+                        init_param(
+                            &storm_control,
+                            CMD,
+                            "storm-control",
+                            0,
+                            0,
+                            INVALID,
+                            0,
+                            "Help : storm-control"
+                        );
+                        libcli_register_param(&if_name, &storm_control);
+                        {
+                            static param_t traffic_type;
+                            init_param(
+                                &traffic_type,
+                                LEAF,
+                                0,
+                                0,
+                                validate_traffic_type,
+                                STRING,
+                                "traffic-type",
+                                "Help : broadcast|multicast|unknown-unicast"
+                            );
+                            libcli_register_param(&storm_control, &traffic_type);
+                            {
+                                static param_t rate;
+                                init_param(
+                                    &rate,
+                                    LEAF,
+                                    0,
+                                    intf_storm_control_handler,
+                                    validate_storm_control_rate,
+                                    INT,
+                                    "rate",
+                                    "Help : packets per second, 0 for unlimited"
+                                );
+                                libcli_register_param(&traffic_type, &rate);
+                                set_param_cmd_code(&rate, CMDCODE_CONFIG_INTF_STORM_CONTROL);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
 
     support_cmd_negation(config);
 }
@@ -0,0 +1,188 @@
+/**
+ * @file open_addressing_table.hpp
+ * @author Jayson Sho Toma
+ * @brief hash table storing entries inline, shared by the L2 tables.
+ * @version 0.1
+ * @date 2022-05-12
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @class OpenAddressingTable
+ * @brief open-addressing hash table keyed by an unsigned integer, with the entries stored inline in the slots.
+ *        Keys are placed by fibonacci hashing and collisions are resolved by linear probing.
+ *        Deletions shift the following entries back instead of leaving tombstones, so lookups never
+ *        slow down as entries come and go. The table doubles its capacity when it gets half full.
+ *        Pointers to entries are valid until the table is modified.
+ *
+ * @tparam Key unsigned integer type of the keys, 32 or 64 bits long
+ * @tparam Entry type of the entries, default constructible
+ * @tparam EmptyKey key value which marks empty slots, never inserted
+ */
+template <typename Key, typename Entry, Key EmptyKey>
+class OpenAddressingTable {
+    static_assert(std::is_unsigned<Key>::value && (sizeof(Key) == 4 || sizeof(Key) == 8),
+        "keys must be 32 or 64-bit unsigned integers");
+
+public:
+    /**
+     * @brief Construct a new OpenAddressingTable object
+     *
+     * @param initial_capacity number of slots, a power of 2
+     */
+    explicit OpenAddressingTable(uint32_t initial_capacity) :
+        mask(0),
+        hash_shift(0),
+        entry_count(0)
+    {
+        resize(initial_capacity);
+    }
+
+    /**
+     * @brief finds the entry of `key`.
+     *
+     * @param key key of the entry
+     * @return Entry* entry stored in the table. nullptr if not found.
+     */
+    Entry *find(Key key)
+    {
+        Slot &slot = slots[findSlot(key)];
+        return slot.key == EmptyKey ? nullptr : &slot.entry;
+    }
+
+    const Entry *find(Key key) const
+    {
+        const Slot &slot = slots[findSlot(key)];
+        return slot.key == EmptyKey ? nullptr : &slot.entry;
+    }
+
+    /**
+     * @brief finds the entry of `key`, or adds a default constructed one.
+     *
+     * @param key key of the entry, other than EmptyKey
+     * @return std::pair<Entry *, bool> the entry, and true if it has just been added
+     */
+    std::pair<Entry *, bool> insert(Key key)
+    {
+        uint32_t i = findSlot(key);
+        if (slots[i].key == key) {
+            return { &slots[i].entry, false };
+        }
+
+        if ((entry_count + 1) * 2 > slots.size()) {
+            resize(slots.size() * 2);
+            i = findSlot(key);
+        }
+        slots[i].key = key;
+        slots[i].entry = Entry();
+        entry_count++;
+        return { &slots[i].entry, true };
+    }
+
+    /**
+     * @brief removes the entry of `key`.
+     *
+     * @param key key of the entry
+     * @return true if the entry has been removed
+     * @return false if not found
+     */
+    bool erase(Key key)
+    {
+        uint32_t i = findSlot(key);
+        if (slots[i].key == EmptyKey) {
+            return false;
+        }
+        entry_count--;
+
+        // shift back the entries of the probe sequence which would become unreachable across the hole
+        for (uint32_t j = (i + 1) & mask; slots[j].key != EmptyKey; j = (j + 1) & mask) {
+            uint32_t home = getHomeSlot(slots[j].key);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                slots[i].key = slots[j].key;
+                slots[i].entry = std::move(slots[j].entry);
+                i = j;
+            }
+        }
+        slots[i].key = EmptyKey;
+        slots[i].entry = Entry();
+        return true;
+    }
+
+    uint32_t size() const
+    {
+        return entry_count;
+    }
+
+    /**
+     * @brief calls `visitor` with every key and entry, in slot order.
+     *
+     * @param visitor callback taking `Key` and `const Entry &`. it must not modify the table.
+     */
+    template <typename Visitor>
+    void forEach(Visitor &&visitor) const
+    {
+        for (const auto &slot : slots) {
+            if (slot.key != EmptyKey) {
+                visitor(slot.key, slot.entry);
+            }
+        }
+    }
+
+private:
+    // 2^bits divided by the golden ratio
+    static constexpr Key FIBONACCI_MULTIPLIER = static_cast<Key>(sizeof(Key) == 8 ? 0x9E3779B97F4A7C15ull : 0x9E3779B9u);
+
+    struct Slot {
+        Key key;
+        Entry entry;
+    };
+
+    uint32_t getHomeSlot(Key key) const
+    {
+        // fibonacci hashing spreads consecutive keys such as the hosts of a subnet over the table
+        return static_cast<uint32_t>(static_cast<Key>(key * FIBONACCI_MULTIPLIER) >> hash_shift);
+    }
+
+    /**
+     * @brief returns the slot holding `key`, or the empty slot where `key` would be inserted.
+     *
+     * @param key key of the entry
+     * @return uint32_t index of the slot
+     */
+    uint32_t findSlot(Key key) const
+    {
+        // the table is never more than half full, so the probe always reaches an empty slot
+        uint32_t i = getHomeSlot(key);
+        while (slots[i].key != key && slots[i].key != EmptyKey) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    void resize(uint32_t capacity)
+    {
+        std::vector<Slot> old_slots(capacity, Slot{ EmptyKey, Entry() });
+        old_slots.swap(slots);
+        mask = capacity - 1;
+        hash_shift = sizeof(Key) * 8 - __builtin_ctz(capacity);
+
+        for (auto &slot : old_slots) {
+            if (slot.key != EmptyKey) {
+                Slot &new_slot = slots[findSlot(slot.key)];
+                new_slot.key = slot.key;
+                new_slot.entry = std::move(slot.entry);
+            }
+        }
+    }
+
+    std::vector<Slot> slots;
+    uint32_t mask;
+    uint32_t hash_shift;
+    uint32_t entry_count;
+};
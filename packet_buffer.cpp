@@ -0,0 +1,150 @@
+/**
+ * @file packet_buffer.cpp
+ * @author Jayson Sho Toma
+ * @brief reference counted packet buffer allocated from per-thread pools.
+ * @version 0.1
+ * @date 2022-05-08
+ */
+
+#include "packet_buffer.hpp"
+
+#include <cstring>
+#include <new>
+
+PacketBuffer::PacketBuffer(SizeClass size_class) :
+    size_class(size_class),
+    ref_count(1),
+    head(DEFAULT_HEADROOM),
+    length(0),
+    buffer(reinterpret_cast<char *>(this + 1))
+{
+}
+
+PacketBuffer *PacketBuffer::create(SizeClass size_class)
+{
+    void *memory = ::operator new(sizeof(PacketBuffer) + DEFAULT_HEADROOM + getMaxFrameSize(size_class));
+    return new (memory) PacketBuffer(size_class);
+}
+
+void PacketBuffer::destroy(PacketBuffer *buffer)
+{
+    buffer->~PacketBuffer();
+    ::operator delete(buffer);
+}
+
+PacketBuffer::FreeList::~FreeList()
+{
+    for (auto &buffer : buffers) {
+        destroy(buffer);
+    }
+}
+
+PacketBuffer *PacketBuffer::allocate(SizeClass size_class)
+{
+    FreeList &free_list = free_lists[static_cast<uint32_t>(size_class)];
+    if (free_list.buffers.empty()) {
+        return create(size_class);
+    }
+
+    PacketBuffer *buffer = free_list.buffers.back();
+    free_list.buffers.pop_back();
+    buffer->ref_count = 1;
+    buffer->reset();
+    return buffer;
+}
+
+PacketBuffer *PacketBuffer::allocate(const char *data, uint32_t size)
+{
+    if (size > MAX_PACKET_BUFFER_SIZE) {
+        return nullptr;
+    }
+    PacketBuffer *buffer = allocate(getSizeClass(size));
+    memcpy(buffer->getData(), data, size);
+    buffer->length = size;
+    return buffer;
+}
+
+PacketBuffer *PacketBuffer::clone() const
+{
+    PacketBuffer *buffer = allocate(size_class);
+    buffer->head = head;
+    buffer->length = length;
+    memcpy(buffer->getData(), getData(), length);
+    return buffer;
+}
+
+void PacketBuffer::release()
+{
+    if (--ref_count) {
+        return;
+    }
+    FreeList &free_list = free_lists[static_cast<uint32_t>(size_class)];
+    if (free_list.buffers.size() >= MAX_FREE_BUFFERS_PER_THREAD[static_cast<uint32_t>(size_class)]) {
+        destroy(this);
+        return;
+    }
+    free_list.buffers.push_back(this);
+}
+
+bool PacketBuffer::setLength(uint32_t length)
+{
+    if (head + length > getCapacity()) {
+        return false;
+    }
+    this->length = length;
+    return true;
+}
+
+char *PacketBuffer::pushHeader(uint32_t size)
+{
+    if (size > head) {
+        return nullptr;
+    }
+    head -= size;
+    length += size;
+    return getData();
+}
+
+char *PacketBuffer::pullHeader(uint32_t size)
+{
+    if (size > length) {
+        return nullptr;
+    }
+    head += size;
+    length -= size;
+    return getData();
+}
+
+char *PacketBuffer::appendTrailer(uint32_t size)
+{
+    if (size > getTailroom()) {
+        return nullptr;
+    }
+    char *trailer = getData() + length;
+    length += size;
+    return trailer;
+}
+
+uint32_t EgressFrame::copyTo(char *buffer) const
+{
+    iovec segments[MAX_SEGMENTS];
+    uint32_t segment_count = getSegments(segments);
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < segment_count; i++) {
+        memcpy(buffer + size, segments[i].iov_base, segments[i].iov_len);
+        size += segments[i].iov_len;
+    }
+    return size;
+}
+
+PacketBuffer *EgressFrame::clonePacket() const
+{
+    PacketBuffer *buffer = packet->clone();
+    if (omit_size) {
+        // close the gap by moving the bytes in front of it, which is the shorter side for header fields
+        char *data = buffer->getData();
+        memmove(data + omit_size, data, omit_offset);
+        buffer->pullHeader(omit_size);
+    }
+    return buffer;
+}
@@ -0,0 +1,318 @@
+/**
+ * @file packet_buffer.hpp
+ * @author Jayson Sho Toma
+ * @brief reference counted packet buffer allocated from per-thread pools.
+ * @version 0.1
+ * @date 2022-05-08
+ */
+
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "comm.hpp"
+
+/**
+ * @class PacketBuffer
+ * @brief buffer which holds a single frame, with room reserved in front of it (headroom) and behind it (tailroom).
+ *        Buffers come in two size classes : standard buffers hold frames of the default MTU,
+ *        jumbo buffers are used only for frames which do not fit in a standard one.
+ *        Buffers are reference counted and recycled through a free list per size class owned by the releasing thread,
+ *        so the steady-state data path does not touch the heap.
+ *        A buffer is used by one thread at a time, hence the reference count is not atomic.
+ */
+class PacketBuffer {
+public:
+    static constexpr uint32_t DEFAULT_HEADROOM = 64;
+
+    /**
+     * @brief size class of a buffer
+     *
+     */
+    enum class SizeClass {
+        STANDARD, /* STANDARD_PACKET_BUFFER_SIZE bytes behind the default headroom */
+        JUMBO,    /* MAX_PACKET_BUFFER_SIZE bytes behind the default headroom */
+    };
+
+    static constexpr uint32_t SIZE_CLASS_COUNT = 2;
+
+    /**
+     * @brief returns the smallest size class holding a frame of `frame_size` bytes behind the default headroom.
+     *
+     * @param frame_size size of the frame, up to MAX_PACKET_BUFFER_SIZE
+     * @return SizeClass
+     */
+    static SizeClass getSizeClass(uint32_t frame_size)
+    {
+        return frame_size <= STANDARD_PACKET_BUFFER_SIZE ? SizeClass::STANDARD : SizeClass::JUMBO;
+    }
+
+    /**
+     * @brief returns the size of the largest frame held by a buffer of `size_class` behind the default headroom.
+     *
+     * @param size_class size class
+     * @return uint32_t
+     */
+    static uint32_t getMaxFrameSize(SizeClass size_class)
+    {
+        return size_class == SizeClass::STANDARD ? STANDARD_PACKET_BUFFER_SIZE : MAX_PACKET_BUFFER_SIZE;
+    }
+
+    /**
+     * @brief returns an empty buffer whose data starts after DEFAULT_HEADROOM bytes.
+     *        the reference count of the buffer is 1.
+     *
+     * @param size_class size class of the buffer
+     * @return PacketBuffer*
+     */
+    static PacketBuffer *allocate(SizeClass size_class = SizeClass::STANDARD);
+
+    /**
+     * @brief returns a buffer of the smallest size class holding a copy of `data`.
+     *
+     * @param data frame to be copied
+     * @param size size of the frame
+     * @return PacketBuffer*. nullptr if the frame does not fit in a jumbo buffer.
+     */
+    static PacketBuffer *allocate(const char *data, uint32_t size);
+
+    PacketBuffer(const PacketBuffer &) = delete;
+    PacketBuffer &operator=(const PacketBuffer &) = delete;
+
+    /**
+     * @brief returns a private copy of this buffer, of the same size class. the frame keeps the same headroom.
+     *
+     * @return PacketBuffer*
+     */
+    PacketBuffer *clone() const;
+
+    /**
+     * @brief takes an additional reference to the buffer.
+     *
+     */
+    void retain()
+    {
+        ref_count++;
+    }
+
+    /**
+     * @brief drops a reference. the buffer goes back to the pool of the calling thread when no reference is left.
+     *
+     */
+    void release();
+
+    uint32_t getRefCount() const
+    {
+        return ref_count;
+    }
+
+    /**
+     * @brief checks whether the buffer is referenced by others. shared buffers must not be modified.
+     *
+     * @return true if more than one reference exists
+     * @return false otherwise
+     */
+    bool isShared() const
+    {
+        return ref_count > 1;
+    }
+
+    char *getData()
+    {
+        return buffer + head;
+    }
+
+    const char *getData() const
+    {
+        return buffer + head;
+    }
+
+    uint32_t getLength() const
+    {
+        return length;
+    }
+
+    /**
+     * @brief sets the length of the frame. the frame can grow into the tailroom.
+     *
+     * @param length new length of the frame
+     * @return true if the frame fits in the buffer
+     * @return false otherwise
+     */
+    bool setLength(uint32_t length);
+
+    uint32_t getHeadroom() const
+    {
+        return head;
+    }
+
+    uint32_t getTailroom() const
+    {
+        return getCapacity() - head - length;
+    }
+
+    SizeClass getSizeClass() const
+    {
+        return size_class;
+    }
+
+    /**
+     * @brief returns the size of the whole buffer, including the headroom.
+     *
+     * @return uint32_t
+     */
+    uint32_t getCapacity() const
+    {
+        return DEFAULT_HEADROOM + getMaxFrameSize(size_class);
+    }
+
+    /**
+     * @brief adds room for a header in front of the frame. only the head offset moves, the frame stays in place.
+     *
+     * @param size size of the header
+     * @return char* head of the new header, which is the new head of the frame. nullptr if the headroom is too small.
+     */
+    char *pushHeader(uint32_t size);
+
+    /**
+     * @brief strips a header from the front of the frame. only the head offset moves, the frame stays in place.
+     *
+     * @param size size of the header
+     * @return char* new head of the frame. nullptr if the frame is shorter than `size`.
+     */
+    char *pullHeader(uint32_t size);
+
+    /**
+     * @brief adds room for a trailer at the end of the frame.
+     *
+     * @param size size of the trailer
+     * @return char* head of the new trailer. nullptr if the tailroom is too small.
+     */
+    char *appendTrailer(uint32_t size);
+
+    /**
+     * @brief empties the buffer and restores the default headroom. the buffer must not be shared.
+     *
+     */
+    void reset()
+    {
+        head = DEFAULT_HEADROOM;
+        length = 0;
+    }
+
+private:
+    // jumbo buffers are rarely needed, so fewer of them are kept around
+    static constexpr uint32_t MAX_FREE_BUFFERS_PER_THREAD[SIZE_CLASS_COUNT] = { 256, 32 };
+
+    explicit PacketBuffer(SizeClass size_class);
+    ~PacketBuffer() = default;
+
+    /**
+     * @brief creates a buffer whose storage is allocated right behind the object.
+     *
+     * @param size_class size class of the buffer
+     * @return PacketBuffer*
+     */
+    static PacketBuffer *create(SizeClass size_class);
+
+    static void destroy(PacketBuffer *buffer);
+
+    /**
+     * @brief buffers of a size class released by the owning thread, freed on thread exit
+     *
+     */
+    struct FreeList {
+        std::vector<PacketBuffer *> buffers;
+        ~FreeList();
+    };
+
+    SizeClass size_class;
+    uint32_t ref_count;
+    uint32_t head;
+    uint32_t length;
+    char *buffer; /* getCapacity() bytes following the object */
+
+    inline static thread_local FreeList free_lists[SIZE_CLASS_COUNT];
+};
+
+/**
+ * @struct EgressFrame
+ * @brief frame leaving an interface : a packet buffer, optionally with a range of its bytes left out on the wire.
+ *        Transports gather the remaining bytes straight from the buffer, so the buffer is never modified
+ *        and can be shared by all the ports sending the frame.
+ */
+struct EgressFrame {
+    static constexpr uint32_t MAX_SEGMENTS = 2;
+
+    PacketBuffer *packet;
+    uint32_t omit_offset;
+    uint32_t omit_size;
+
+    explicit EgressFrame(PacketBuffer *packet) :
+        packet(packet),
+        omit_offset(0),
+        omit_size(0)
+    {
+    }
+
+    /**
+     * @brief leaves `size` bytes at `offset` of the frame out of the wire.
+     *
+     * @param offset offset from the head of the frame
+     * @param size number of bytes to be left out
+     */
+    void omit(uint32_t offset, uint32_t size)
+    {
+        omit_offset = offset;
+        omit_size = size;
+    }
+
+    /**
+     * @brief returns the number of bytes put on the wire
+     *
+     * @return uint32_t
+     */
+    uint32_t getLength() const
+    {
+        return packet->getLength() - omit_size;
+    }
+
+    /**
+     * @brief describes the bytes put on the wire as segments of the packet buffer.
+     *
+     * @param segments array of at least MAX_SEGMENTS entries to be filled
+     * @return uint32_t number of segments filled
+     */
+    uint32_t getSegments(iovec *segments) const
+    {
+        char *data = packet->getData();
+        if (!omit_size) {
+            segments[0].iov_base = data;
+            segments[0].iov_len = packet->getLength();
+            return 1;
+        }
+        segments[0].iov_base = data;
+        segments[0].iov_len = omit_offset;
+        segments[1].iov_base = data + omit_offset + omit_size;
+        segments[1].iov_len = packet->getLength() - omit_offset - omit_size;
+        return 2;
+    }
+
+    /**
+     * @brief copies the bytes put on the wire to `buffer`.
+     *
+     * @param buffer destination, at least `getLength()` bytes long
+     * @return uint32_t number of bytes copied
+     */
+    uint32_t copyTo(char *buffer) const;
+
+    /**
+     * @brief returns a private buffer holding the bytes put on the wire.
+     *
+     * @return PacketBuffer*
+     */
+    PacketBuffer *clonePacket() const;
+};
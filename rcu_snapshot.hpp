@@ -0,0 +1,83 @@
+/**
+ * @file rcu_snapshot.hpp
+ * @author Jayson Sho Toma
+ * @brief publication of immutable snapshots which are read without locks (RCU style).
+ * @version 0.1
+ * @date 2022-05-10
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class RCUSnapshot
+ * @brief holds the latest snapshot of a structure owned by a single writer thread.
+ *        The writer publishes a new snapshot by swapping a pointer, readers use the snapshot they found
+ *        for as long as their read section lasts. A replaced snapshot is freed by a later publication
+ *        once no reader is inside a read section, so neither side ever waits for the other.
+ *
+ * @tparam T type of the snapshot
+ */
+template <typename T>
+class RCUSnapshot {
+public:
+    RCUSnapshot() :
+        current(nullptr),
+        active_readers(0)
+    {
+    }
+
+    ~RCUSnapshot()
+    {
+        delete current.load();
+        for (auto &snapshot : retired) {
+            delete snapshot;
+        }
+    }
+
+    RCUSnapshot(const RCUSnapshot &) = delete;
+    RCUSnapshot &operator=(const RCUSnapshot &) = delete;
+
+    /**
+     * @brief replaces the current snapshot. writer side.
+     *
+     * @param snapshot new snapshot, owned by this object from now on
+     */
+    void publish(T *snapshot)
+    {
+        if (T *old_snapshot = current.exchange(snapshot); old_snapshot) {
+            retired.push_back(old_snapshot);
+        }
+
+        // a reader entering from now on can only find the new snapshot
+        if (active_readers.load() == 0) {
+            for (auto &retired_snapshot : retired) {
+                delete retired_snapshot;
+            }
+            retired.clear();
+        }
+    }
+
+    /**
+     * @brief calls `reader` with the current snapshot. reader side, any thread.
+     *
+     * @param reader callback taking `const T *`, which is nullptr until the first publication.
+     *               the snapshot must not be used after the callback returns.
+     */
+    template <typename Reader>
+    void read(Reader &&reader) const
+    {
+        active_readers.fetch_add(1);
+        reader(static_cast<const T *>(current.load()));
+        active_readers.fetch_sub(1);
+    }
+
+private:
+    std::atomic<T *> current;
+    mutable std::atomic<uint32_t> active_readers;
+    // replaced snapshots which readers may still be using. touched only by the writer.
+    std::vector<T *> retired;
+};
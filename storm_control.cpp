@@ -0,0 +1,122 @@
+/**
+ * @file storm_control.cpp
+ * @author Jayson Sho Toma
+ * @brief per-port rate limits of flooded traffic enforced with token buckets.
+ * @version 0.1
+ * @date 2022-05-11
+ */
+
+#include "storm_control.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+TokenBucket::TokenBucket() :
+    rate(0),
+    applied_rate(0),
+    tokens(0),
+    last_refill_ns(0)
+{
+}
+
+bool TokenBucket::consume(uint64_t now_ns)
+{
+    uint32_t rate = getRate();
+    if (!rate) {
+        return true;
+    }
+
+    uint64_t capacity = static_cast<uint64_t>(rate) * NS_PER_SEC;
+    uint64_t elapsed_ns = now_ns - last_refill_ns;
+    last_refill_ns = now_ns;
+
+    if (rate != applied_rate || elapsed_ns >= NS_PER_SEC) {
+        // a newly configured bucket, or one idle long enough to be refilled entirely
+        applied_rate = rate;
+        tokens = capacity;
+    }
+    else {
+        // elapsed_ns * rate stays below NS_PER_SEC * MAX_RATE, far from overflowing
+        tokens = std::min(capacity, tokens + elapsed_ns * rate);
+    }
+
+    if (tokens < NS_PER_SEC) {
+        return false;
+    }
+    tokens -= NS_PER_SEC;
+    return true;
+}
+
+bool StormControl::tryParseTrafficType(const std::string &name, TrafficType *type)
+{
+    for (TrafficType candidate : { TrafficType::BROADCAST, TrafficType::MULTICAST, TrafficType::UNKNOWN_UNICAST }) {
+        if (getTrafficTypeName(candidate) == name) {
+            *type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *StormControl::getTrafficTypeName(TrafficType type)
+{
+    switch (type) {
+    case TrafficType::BROADCAST:
+        return "broadcast";
+    case TrafficType::MULTICAST:
+        return "multicast";
+    case TrafficType::UNKNOWN_UNICAST:
+        return "unknown-unicast";
+    }
+    return "";
+}
+
+StormControl::StormControl()
+{
+    for (auto &drop_count : drop_counts) {
+        drop_count.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool StormControl::setRate(TrafficType type, uint32_t rate)
+{
+    if (rate > TokenBucket::MAX_RATE) {
+        std::cout << "Error : storm control rate must not exceed " << TokenBucket::MAX_RATE << " packets per second" << std::endl;
+        return false;
+    }
+    buckets[static_cast<uint32_t>(type)].setRate(rate);
+    return true;
+}
+
+bool StormControl::admit(TrafficType type)
+{
+    TokenBucket &bucket = buckets[static_cast<uint32_t>(type)];
+    // unlimited traffic does not pay for reading the clock
+    if (!bucket.getRate()) {
+        return true;
+    }
+
+    uint64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (bucket.consume(now_ns)) {
+        return true;
+    }
+    std::atomic<uint64_t> &drop_count = drop_counts[static_cast<uint32_t>(type)];
+    drop_count.store(drop_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return false;
+}
+
+void StormControl::dump() const
+{
+    for (TrafficType type : { TrafficType::BROADCAST, TrafficType::MULTICAST, TrafficType::UNKNOWN_UNICAST }) {
+        std::cout << "  " << getTrafficTypeName(type) << " : ";
+        if (getRate(type)) {
+            std::cout << getRate(type) << " pps";
+        }
+        else {
+            std::cout << "unlimited";
+        }
+        std::cout << ", dropped : " << getDropCount(type) << std::endl;
+    }
+}
@@ -0,0 +1,136 @@
+/**
+ * @file storm_control.hpp
+ * @author Jayson Sho Toma
+ * @brief per-port rate limits of flooded traffic enforced with token buckets.
+ * @version 0.1
+ * @date 2022-05-11
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "printer.hpp"
+
+/**
+ * @class TokenBucket
+ * @brief admits up to `rate` packets per second, with bursts of up to one second worth of packets.
+ *        Tokens are counted in 1 / NS_PER_SEC packets, so that refilling is a single multiplication
+ *        of the elapsed nanoseconds and no division is needed on the packet path.
+ *        The rate may be changed by any thread, tokens are consumed by a single thread.
+ */
+class TokenBucket {
+public:
+    static constexpr uint64_t NS_PER_SEC = 1000000000;
+    static constexpr uint32_t MAX_RATE = 10000000;
+
+    TokenBucket();
+
+    /**
+     * @brief sets the rate limit. the bucket starts full on the next packet.
+     *
+     * @param rate packets per second, up to MAX_RATE. 0 removes the limit.
+     */
+    void setRate(uint32_t rate)
+    {
+        this->rate.store(rate, std::memory_order_relaxed);
+    }
+
+    uint32_t getRate() const
+    {
+        return rate.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief takes a token for a packet.
+     *
+     * @param now_ns current time in nanoseconds of a monotonic clock
+     * @return true if the packet is admitted
+     * @return false if the bucket is empty
+     */
+    bool consume(uint64_t now_ns);
+
+private:
+    std::atomic<uint32_t> rate;
+
+    /* touched only by the consuming thread */
+    uint32_t applied_rate;
+    uint64_t tokens;
+    uint64_t last_refill_ns;
+};
+
+/**
+ * @class StormControl
+ * @brief rate limits of broadcast, multicast and unknown unicast frames received on a switch port.
+ *        Frames over the limit are dropped before they are flooded, and counted.
+ */
+class StormControl : public IPrinter {
+public:
+    /**
+     * @brief class of flooded traffic
+     *
+     */
+    enum class TrafficType {
+        BROADCAST,
+        MULTICAST,
+        UNKNOWN_UNICAST,
+    };
+
+    static constexpr uint32_t TRAFFIC_TYPE_COUNT = 3;
+
+    /**
+     * @brief finds the traffic type by its name.
+     *
+     * @param name name of the traffic type (broadcast, multicast, unknown-unicast)
+     * @param type output traffic type
+     * @return true if `name` matches with a traffic type
+     * @return false otherwise
+     */
+    static bool tryParseTrafficType(const std::string &name, TrafficType *type);
+
+    static const char *getTrafficTypeName(TrafficType type);
+
+    StormControl();
+
+    /**
+     * @brief sets the rate limit of a traffic type.
+     *
+     * @param type traffic type
+     * @param rate packets per second. 0 removes the limit.
+     * @return true if the rate is set
+     * @return false if `rate` exceeds TokenBucket::MAX_RATE
+     */
+    bool setRate(TrafficType type, uint32_t rate);
+
+    uint32_t getRate(TrafficType type) const
+    {
+        return buckets[static_cast<uint32_t>(type)].getRate();
+    }
+
+    /**
+     * @brief checks whether a frame of `type` may be flooded, and counts it as dropped otherwise.
+     *        called by the receiver thread of the node only, which is the only writer of the drop counters.
+     *
+     * @param type traffic type of the frame
+     * @return true if the frame is admitted
+     * @return false if the frame must be dropped
+     */
+    bool admit(TrafficType type);
+
+    uint64_t getDropCount(TrafficType type) const
+    {
+        return drop_counts[static_cast<uint32_t>(type)].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief outputs the rate limits and drop counters on the standard output
+     *
+     */
+    virtual void dump() const override;
+
+private:
+    TokenBucket buckets[TRAFFIC_TYPE_COUNT];
+    std::atomic<uint64_t> drop_counts[TRAFFIC_TYPE_COUNT]; /* written by the receiver thread, read by the CLI */
+};
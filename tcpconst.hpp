@@ -12,4 +12,5 @@
 #define ARP_BROAD_REQ   1
 #define ARP_REPLY       2
 #define ARP_MSG         806
+#define IP_MSG          0x0800
 #define BROADCAST_MAC   0xFFFFFFFFFFFFll
@@ -7,6 +7,8 @@
  */
 
 #include <chrono>
+#include <cstdlib>
+#include <iostream>
 #include <thread>
 
 #include "graph.hpp"
@@ -16,10 +18,22 @@
 
 Graph *topo;
 
-int main()
+int main(int argc, char **argv)
 {
+    // usage : test.out [receiver-thread-count]. a single thread by default, as the direct transport
+    // (config transport direct) runs every node on one thread. pass a larger count to spread nodes over cores.
+    uint32_t receiver_thread_count = 1;
+    if (argc > 1) {
+        int count = std::atoi(argv[1]);
+        if (count <= 0) {
+            std::cout << "Error : receiver thread count must be a positive number" << std::endl;
+            return 1;
+        }
+        receiver_thread_count = static_cast<uint32_t>(count);
+    }
+
     nw_init_cli();
-    topo = build_dualswitch_topo();
+    topo = build_dualswitch_topo(receiver_thread_count);
 
     // wait for few seconds to ensure receiver thread is ready
     std::this_thread::sleep_for(std::chrono::seconds(2));
@@ -0,0 +1,81 @@
+/**
+ * @file timer_wheel.cpp
+ * @author Jayson Sho Toma
+ * @brief hierarchical timer wheel which expires keyed timers in amortized constant time.
+ * @version 0.1
+ * @date 2022-05-09
+ */
+
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(uint64_t current_tick) :
+    current_tick(current_tick),
+    timer_count(0)
+{
+}
+
+void TimerWheel::schedule(uint64_t key, uint64_t expiry_tick)
+{
+    // the slot of the current tick has already been expired
+    place({ key, expiry_tick }, std::max(expiry_tick, current_tick + 1));
+    timer_count++;
+}
+
+void TimerWheel::place(const Timer &timer, uint64_t tick)
+{
+    static constexpr uint64_t MAX_DELTA = (1ull << (LEVEL_BITS * LEVEL_COUNT)) - 1;
+
+    // timers beyond the range of the wheel wait on the farthest slot and get re-placed from there
+    uint64_t delta = std::min(tick - current_tick, MAX_DELTA);
+    uint64_t placement_tick = current_tick + delta;
+
+    uint32_t level = 0;
+    while (level < LEVEL_COUNT - 1 && delta >= (1ull << (LEVEL_BITS * (level + 1)))) {
+        level++;
+    }
+    slots[level][(placement_tick >> (LEVEL_BITS * level)) & (SLOTS_PER_LEVEL - 1)].push_back(timer);
+}
+
+void TimerWheel::cascade(uint32_t level)
+{
+    std::vector<Timer> &slot = slots[level][(current_tick >> (LEVEL_BITS * level)) & (SLOTS_PER_LEVEL - 1)];
+    due_timers.swap(slot);
+    for (const auto &timer : due_timers) {
+        place(timer, std::max(timer.expiry_tick, current_tick));
+    }
+    due_timers.clear();
+}
+
+void TimerWheel::advance(uint64_t now, const ExpiryHandler &handler)
+{
+    while (current_tick < now) {
+        current_tick++;
+
+        // higher levels first, so that timers cascaded into a lower slot due now are cascaded again
+        for (uint32_t level = LEVEL_COUNT - 1; level > 0; level--) {
+            if ((current_tick & ((1ull << (LEVEL_BITS * level)) - 1)) == 0) {
+                cascade(level);
+            }
+        }
+
+        std::vector<Timer> &slot = slots[0][current_tick & (SLOTS_PER_LEVEL - 1)];
+        if (slot.empty()) {
+            continue;
+        }
+
+        // handlers only schedule timers on later ticks, so the slot is not touched while it is processed
+        due_timers.swap(slot);
+        for (const auto &timer : due_timers) {
+            if (timer.expiry_tick > current_tick) {
+                // came down from the farthest slot of the wheel
+                place(timer, timer.expiry_tick);
+                continue;
+            }
+            timer_count--;
+            handler(timer.key, timer.expiry_tick);
+        }
+        due_timers.clear();
+    }
+}
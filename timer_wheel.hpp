@@ -0,0 +1,95 @@
+/**
+ * @file timer_wheel.hpp
+ * @author Jayson Sho Toma
+ * @brief hierarchical timer wheel which expires keyed timers in amortized constant time.
+ * @version 0.1
+ * @date 2022-05-09
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @class TimerWheel
+ * @brief timers identified by a 64-bit key, expiring at an absolute tick.
+ *        Each level holds SLOTS_PER_LEVEL slots, a slot of level `l` spans SLOTS_PER_LEVEL^l ticks.
+ *        Timers are placed on the lowest level whose range covers them and cascade one level down
+ *        whenever the wheel below wraps, so scheduling is O(1) and each timer is moved at most LEVEL_COUNT times.
+ *        Timers cannot be cancelled : owners ignore stale expiries instead (lazy deletion).
+ */
+class TimerWheel {
+public:
+    static constexpr uint32_t LEVEL_BITS = 6;
+    static constexpr uint32_t SLOTS_PER_LEVEL = 1u << LEVEL_BITS;
+    static constexpr uint32_t LEVEL_COUNT = 4;
+
+    /**
+     * @brief callback invoked with the key and the expiry tick of an expired timer.
+     *        it may schedule new timers.
+     *
+     */
+    using ExpiryHandler = std::function<void(uint64_t key, uint64_t expiry_tick)>;
+
+    /**
+     * @brief Construct a new TimerWheel object
+     *
+     * @param current_tick tick the wheel starts from
+     */
+    explicit TimerWheel(uint64_t current_tick = 0);
+
+    /**
+     * @brief schedules a timer. a timer expiring at or before the current tick expires on the next tick.
+     *
+     * @param key identifier passed back to the expiry handler
+     * @param expiry_tick absolute tick on which the timer expires
+     */
+    void schedule(uint64_t key, uint64_t expiry_tick);
+
+    /**
+     * @brief moves the wheel forward to `now` and expires all the timers due by then.
+     *
+     * @param now current tick. nothing happens if it is not ahead of the wheel.
+     * @param handler callback invoked for each expired timer
+     */
+    void advance(uint64_t now, const ExpiryHandler &handler);
+
+    uint64_t getCurrentTick() const
+    {
+        return current_tick;
+    }
+
+    uint64_t getTimerCount() const
+    {
+        return timer_count;
+    }
+
+private:
+    struct Timer {
+        uint64_t key;
+        uint64_t expiry_tick;
+    };
+
+    /**
+     * @brief puts the timer into the slot covering `tick`.
+     *
+     * @param timer timer to be placed
+     * @param tick tick on which the timer is taken out of the wheel, not behind the current tick
+     */
+    void place(const Timer &timer, uint64_t tick);
+
+    /**
+     * @brief re-places the timers of the slot of level `level` which covers the current tick.
+     *
+     * @param level level of the slot, 1 or higher
+     */
+    void cascade(uint32_t level);
+
+    uint64_t current_tick;
+    uint64_t timer_count;
+    std::vector<Timer> slots[LEVEL_COUNT][SLOTS_PER_LEVEL];
+    // timers being expired or cascaded, kept to reuse its allocation
+    std::vector<Timer> due_timers;
+};
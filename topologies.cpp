@@ -30,7 +30,7 @@
       +-------+                                              +----------+
 
  */
-Graph *build_first_topo()
+Graph *build_first_topo(uint32_t receiver_thread_count)
 {
     Graph *topo = new Graph("Hello World Generic Graph");
     Node *R0_re = topo->addNode("R0_re");
@@ -53,6 +53,7 @@ Graph *build_first_topo()
     R2_re->setInterfaceIPAddress("eth0/3", "30.1.1.2", 24);
     R2_re->setInterfaceIPAddress("eth0/5", "40.1.1.2", 24);
 
+    topo->setReceiverThreadCount(receiver_thread_count);
     topo->startPacketReceiverThread();
 
     return topo;
@@ -86,7 +87,7 @@ Graph *build_first_topo()
                                       |            |
                                       +------------+
 */
-Graph *build_simple_l2_switch_topo()
+Graph *build_simple_l2_switch_topo(uint32_t receiver_thread_count)
 {
     Graph *topo = new Graph("Simple L2 Switch Demo graph");
     Node *H1 = topo->addNode("H1");
@@ -117,6 +118,7 @@ Graph *build_simple_l2_switch_topo()
     nodeSetInterfaceL2Mode(L2SW, "eth0/3", InterfaceNetworkProperty::L2Mode::ACCESS);
     nodeSetInterfaceL2Mode(L2SW, "eth0/4", InterfaceNetworkProperty::L2Mode::ACCESS);
 
+    topo->setReceiverThreadCount(receiver_thread_count);
     topo->startPacketReceiverThread();
 
     return topo;
@@ -154,7 +156,7 @@ Graph *build_simple_l2_switch_topo()
                                    +--------+|                                   +--------+
 #endif
 */
-Graph *build_dualswitch_topo()
+Graph *build_dualswitch_topo(uint32_t receiver_thread_count)
 {
     Graph *topo = new Graph("Dual Switch Topo");
     Node *H1 = topo->addNode("H1");
@@ -209,6 +211,7 @@ Graph *build_dualswitch_topo()
     nodeSetInterfaceL2Mode(L2SW2, "eth0/12", InterfaceNetworkProperty::L2Mode::ACCESS);
     nodeSetInterfaceVLANMembership(L2SW2, "eth0/12", 11);
 
+    topo->setReceiverThreadCount(receiver_thread_count);
     topo->startPacketReceiverThread();
 
     return topo;
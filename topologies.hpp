@@ -10,6 +10,10 @@
 
 #include "graph.hpp"
 
-Graph *build_first_topo();
-Graph *build_simple_l2_switch_topo();
-Graph *build_dualswitch_topo();
+/*
+ * topologies are returned with their packet receiver threads started.
+ * nodes are distributed over `receiver_thread_count` threads.
+ */
+Graph *build_first_topo(uint32_t receiver_thread_count = 1);
+Graph *build_simple_l2_switch_topo(uint32_t receiver_thread_count = 1);
+Graph *build_dualswitch_topo(uint32_t receiver_thread_count = 1);
@@ -0,0 +1,186 @@
+/**
+ * @file transport.cpp
+ * @author Jayson Sho Toma
+ * @brief transports which carry frames from an interface to the interface on the other side of the link.
+ * @version 0.1
+ * @date 2022-05-06
+ */
+
+#include "transport.hpp"
+
+#include <cstring>
+
+#include "comm.hpp"
+#include "frame_ring.hpp"
+#include "graph.hpp"
+#include "packet_buffer.hpp"
+#include "uring.hpp"
+
+ITransport *ITransport::getTransport(Type type)
+{
+    static UDPTransport udp_transport;
+    static FrameRingTransport frame_ring_transport;
+    static DirectTransport direct_transport;
+    static IoUringTransport io_uring_transport;
+
+    switch (type) {
+    case Type::UDP:
+        return &udp_transport;
+    case Type::FRAME_RING:
+        return &frame_ring_transport;
+    case Type::DIRECT:
+        return &direct_transport;
+    case Type::IO_URING:
+        return &io_uring_transport;
+    }
+    return &udp_transport;
+}
+
+bool ITransport::tryParseType(const std::string &name, Type *type)
+{
+    for (Type candidate : { Type::UDP, Type::FRAME_RING, Type::DIRECT, Type::IO_URING }) {
+        if (getTransport(candidate)->getName() == name) {
+            *type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UDPTransport::attachLink(Link *link)
+{
+    // sockets are opened when the link is created
+    return link->getFromInterface()->initTransmission() && link->getToInterface()->initTransmission();
+}
+
+int UDPTransport::sendPacketOut(Interface *oif, const EgressFrame &frame)
+{
+    int tx_sock_fd = oif->getTransmitSocketFileDescriptor();
+    if (tx_sock_fd < 0) {
+        return -1;
+    }
+
+    char link_header[LinkHeader::MAX_SIZE];
+    uint32_t link_header_size = oif->encodeLinkHeader(link_header);
+    if (!link_header_size) {
+        return -1;
+    }
+
+    EgressBatch *egress_batch = const_cast<Node *>(oif->getNode())->getEgressBatch();
+    if (egress_batch->isOpen()) {
+        return egress_batch->enqueue(link_header, link_header_size, frame, oif->getPeerSocketAddress());
+    }
+
+    // the link header and the frame are gathered by the kernel, nothing is copied here
+    iovec segments[1 + EgressFrame::MAX_SEGMENTS];
+    segments[0].iov_base = link_header;
+    segments[0].iov_len = link_header_size;
+    uint32_t segment_count = 1 + frame.getSegments(segments + 1);
+
+    return ::sendPacketOut(tx_sock_fd, segments, segment_count, oif->getPeerSocketAddress());
+}
+
+bool FrameRingTransport::attachLink(Link *link)
+{
+    return link->attachFrameRings(FrameRing::DEFAULT_CAPACITY);
+}
+
+int FrameRingTransport::sendPacketOut(Interface *oif, const EgressFrame &frame)
+{
+    uint32_t packet_size = frame.getLength();
+    Interface *peer_intf = oif->getPeerInterface();
+    FrameRing *egress_ring = peer_intf ? peer_intf->getIngressRing() : nullptr;
+    if (!egress_ring) {
+        return -1;
+    }
+
+    if (packet_size > MAX_PACKET_BUFFER_SIZE) {
+        egress_ring->countDrop();
+        return -1;
+    }
+    // jumbo frames travel in a private buffer handed over to the receiving thread, copied outside the lock
+    PacketBuffer *jumbo_packet = packet_size > FrameRing::SLOT_SIZE ? frame.clonePacket() : nullptr;
+
+    egress_ring->lockProducer();
+    char *slot = egress_ring->reserve();
+    if (!slot) {
+        egress_ring->unlockProducer();
+        egress_ring->countDrop();
+        if (jumbo_packet) {
+            jumbo_packet->release();
+        }
+        return -1;
+    }
+    bool was_empty;
+    if (jumbo_packet) {
+        was_empty = egress_ring->commitPacket(jumbo_packet);
+    }
+    else {
+        frame.copyTo(slot);
+        was_empty = egress_ring->commit(packet_size);
+    }
+    egress_ring->unlockProducer();
+
+    if (was_empty) {
+        const_cast<Node *>(peer_intf->getNode())->ringDoorbell();
+    }
+    return packet_size;
+}
+
+bool DirectTransport::attachLink(Link *link)
+{
+    return link->getFromInterface()->getPeerInterface() && link->getToInterface()->getPeerInterface();
+}
+
+int DirectTransport::sendPacketOut(Interface *oif, const EgressFrame &frame)
+{
+    Interface *peer_intf = oif->getPeerInterface();
+    if (!peer_intf) {
+        return -1;
+    }
+    if (call_depth >= MAX_CALL_DEPTH) {
+        return -1;
+    }
+
+    // the receiver processes the frame in place, so hand over a private copy
+    PacketBuffer *received_packet = frame.clonePacket();
+    uint32_t packet_size = received_packet->getLength();
+
+    call_depth++;
+    peer_intf->receivePacket(received_packet);
+    call_depth--;
+
+    received_packet->release();
+    return packet_size;
+}
+
+bool IoUringTransport::attachLink(Link *link)
+{
+    return getTransport(Type::UDP)->attachLink(link);
+}
+
+int IoUringTransport::sendPacketOut(Interface *oif, const EgressFrame &frame)
+{
+    IoUringEngine *engine = IoUringEngine::getThreadEngine();
+    if (!engine) {
+        return getTransport(Type::UDP)->sendPacketOut(oif, frame);
+    }
+
+    char link_header[LinkHeader::MAX_SIZE];
+    uint32_t link_header_size = oif->encodeLinkHeader(link_header);
+    if (!link_header_size) {
+        return -1;
+    }
+
+    iovec segments[1 + EgressFrame::MAX_SEGMENTS];
+    segments[0].iov_base = link_header;
+    segments[0].iov_len = link_header_size;
+    uint32_t segment_count = 1 + frame.getSegments(segments + 1);
+
+    int rc = engine->queueSend(oif->getTransmitSocketFileDescriptor(), segments, segment_count);
+    if (rc < 0) {
+        // all send slots are in flight, or the frame is larger than a send slot
+        return getTransport(Type::UDP)->sendPacketOut(oif, frame);
+    }
+    return rc;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file transport.hpp
+ * @author Jayson Sho Toma
+ * @brief transports which carry frames from an interface to the interface on the other side of the link.
+ * @version 0.1
+ * @date 2022-05-06
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// forward declaration
+class Interface;
+class Link;
+struct EgressFrame;
+
+/**
+ * @class ITransport
+ * @brief The interface class of the backends which carry frames between both ends of a link.
+ *        Transports are stateless : per-link state (sockets, rings) is held by the link and its interfaces,
+ *        so a topology can switch its transport at any time.
+ */
+class ITransport {
+public:
+    enum class Type {
+        UDP,        /* UDP loopback socket of the peer node */
+        FRAME_RING, /* in-process lock-free ring drained by the peer node's receiver thread */
+        DIRECT,     /* synchronous call into the peer interface on the sending thread */
+        IO_URING,   /* UDP loopback socket of the peer node, driven by io_uring */
+    };
+
+    /**
+     * @brief returns the transport instance of the given type.
+     *
+     * @param type type of the transport
+     * @return ITransport*
+     */
+    static ITransport *getTransport(Type type);
+
+    /**
+     * @brief finds the transport type by its name.
+     *
+     * @param name name of the transport (udp, ring, direct, io_uring)
+     * @param type output transport type
+     * @return true if `name` matches with a transport
+     * @return false otherwise
+     */
+    static bool tryParseType(const std::string &name, Type *type);
+
+    virtual ~ITransport() {}
+
+    virtual Type getType() const = 0;
+
+    virtual const std::string &getName() const = 0;
+
+    /**
+     * @brief prepares the link so that the transport can carry frames over it.
+     *
+     * @param link link whose endpoints are attached to their nodes
+     * @return true if the link is ready
+     * @return false otherwise
+     */
+    virtual bool attachLink(Link *link) = 0;
+
+    /**
+     * @brief sends a frame out of `oif` to the peer interface.
+     *
+     * @param oif outgoing interface
+     * @param frame frame. the caller keeps its reference to the packet buffer, which must be left unmodified.
+     * @return int size of the sent data. -1 on failure.
+     */
+    virtual int sendPacketOut(Interface *oif, const EgressFrame &frame) = 0;
+};
+
+/**
+ * @class UDPTransport
+ * @brief sends frames to the UDP socket of the peer node. Frames are batched while the sending node processes a receive event.
+ */
+class UDPTransport : public ITransport {
+public:
+    virtual Type getType() const override
+    {
+        return Type::UDP;
+    }
+
+    virtual const std::string &getName() const override
+    {
+        return name;
+    }
+
+    virtual bool attachLink(Link *link) override;
+    virtual int sendPacketOut(Interface *oif, const EgressFrame &frame) override;
+
+private:
+    inline static const std::string name = "udp";
+};
+
+/**
+ * @class FrameRingTransport
+ * @brief enqueues frames to the ring of the peer interface, which is drained by the peer node's receiver thread.
+ */
+class FrameRingTransport : public ITransport {
+public:
+    virtual Type getType() const override
+    {
+        return Type::FRAME_RING;
+    }
+
+    virtual const std::string &getName() const override
+    {
+        return name;
+    }
+
+    virtual bool attachLink(Link *link) override;
+    virtual int sendPacketOut(Interface *oif, const EgressFrame &frame) override;
+
+private:
+    inline static const std::string name = "ring";
+};
+
+/**
+ * @class DirectTransport
+ * @brief passes frames to the peer interface by a synchronous call on the sending thread.
+ *        The whole forwarding path runs on the thread which originated the frame, so frames must only be
+ *        sent from the receiver thread, and the graph refuses this transport with more than one of them.
+ */
+class DirectTransport : public ITransport {
+public:
+    virtual Type getType() const override
+    {
+        return Type::DIRECT;
+    }
+
+    virtual const std::string &getName() const override
+    {
+        return name;
+    }
+
+    virtual bool attachLink(Link *link) override;
+    virtual int sendPacketOut(Interface *oif, const EgressFrame &frame) override;
+
+private:
+    inline static const std::string name = "direct";
+    // bounds the recursion caused by forwarding loops
+    static constexpr uint32_t MAX_CALL_DEPTH = 64;
+    inline static thread_local uint32_t call_depth = 0;
+};
+
+/**
+ * @class IoUringTransport
+ * @brief sends frames to the UDP socket of the peer node through the io_uring engine of the sending thread.
+ *        Sends are submitted together at the end of each event loop round.
+ *        Threads without an engine (e.g. the CLI thread) fall back to the UDP transport.
+ */
+class IoUringTransport : public ITransport {
+public:
+    virtual Type getType() const override
+    {
+        return Type::IO_URING;
+    }
+
+    virtual const std::string &getName() const override
+    {
+        return name;
+    }
+
+    virtual bool attachLink(Link *link) override;
+    virtual int sendPacketOut(Interface *oif, const EgressFrame &frame) override;
+
+private:
+    inline static const std::string name = "io_uring";
+};
@@ -0,0 +1,489 @@
+/**
+ * @file uring.cpp
+ * @author Jayson Sho Toma
+ * @brief io_uring based UDP frame I/O used by the receiver threads.
+ * @version 0.1
+ * @date 2022-05-07
+ */
+
+#include "uring.hpp"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+IoUring::IoUring(uint32_t entries) :
+    ring_fd(-1),
+    sq_entries(0),
+    sq_ring_ptr(MAP_FAILED),
+    sq_ring_size(0),
+    cq_ring_ptr(MAP_FAILED),
+    cq_ring_size(0),
+    sqes(static_cast<io_uring_sqe *>(MAP_FAILED)),
+    sqes_size(0),
+    sq_head(nullptr),
+    sq_tail(nullptr),
+    sq_mask(0),
+    sqe_tail(0),
+    cq_head(nullptr),
+    cq_tail(nullptr),
+    cq_mask(0),
+    cqes(nullptr)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        std::cout << "Error : io_uring_setup() failed, errno = " << errno << std::endl;
+        return;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring_ptr = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ptr == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    if (single_mmap) {
+        cq_ring_ptr = sq_ring_ptr;
+    }
+    else {
+        cq_ring_ptr = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ptr == MAP_FAILED) {
+            munmap(sq_ring_ptr, sq_ring_size);
+            sq_ring_ptr = MAP_FAILED;
+            close(fd);
+            return;
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) {
+        if (!single_mmap) {
+            munmap(cq_ring_ptr, cq_ring_size);
+        }
+        munmap(sq_ring_ptr, sq_ring_size);
+        sq_ring_ptr = cq_ring_ptr = MAP_FAILED;
+        close(fd);
+        return;
+    }
+
+    char *sq = static_cast<char *>(sq_ring_ptr);
+    sq_head = reinterpret_cast<uint32_t *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sqe_tail = *sq_tail;
+
+    // submission queue entries are always used in ring order
+    uint32_t *sq_array = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+    for (uint32_t i = 0; i < sq_entries; i++) {
+        sq_array[i] = i;
+    }
+
+    char *cq = static_cast<char *>(cq_ring_ptr);
+    cq_head = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    ring_fd = fd;
+}
+
+IoUring::~IoUring()
+{
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring_ptr != MAP_FAILED && cq_ring_ptr != sq_ring_ptr) {
+        munmap(cq_ring_ptr, cq_ring_size);
+    }
+    if (sq_ring_ptr != MAP_FAILED) {
+        munmap(sq_ring_ptr, sq_ring_size);
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+    }
+    ring_fd = -1;
+}
+
+io_uring_sqe *IoUring::getSqe()
+{
+    if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+        return nullptr;
+    }
+    io_uring_sqe *sqe = &sqes[sqe_tail & sq_mask];
+    sqe_tail++;
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    return sqe;
+}
+
+int IoUring::submit()
+{
+    uint32_t to_submit = sqe_tail - *sq_tail;
+    if (!to_submit) {
+        return 0;
+    }
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    int rc = syscall(__NR_io_uring_enter, ring_fd, to_submit, 0, 0, nullptr, 0);
+    return rc < 0 ? -errno : rc;
+}
+
+int IoUring::submitAndWait(uint32_t wait_nr)
+{
+    uint32_t to_submit = sqe_tail - *sq_tail;
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    int rc = syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_nr, IORING_ENTER_GETEVENTS, nullptr, 0);
+    return rc < 0 ? -errno : rc;
+}
+
+io_uring_cqe *IoUring::peekCqe()
+{
+    uint32_t head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        return nullptr;
+    }
+    return &cqes[head & cq_mask];
+}
+
+void IoUring::cqeSeen()
+{
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
+
+bool IoUring::registerBuffers(const iovec *iovs, uint32_t n_iovs)
+{
+    return syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iovs, n_iovs) == 0;
+}
+
+IoUringEngine::IoUringEngine() :
+    uring(RING_ENTRIES),
+    is_ready(false),
+    receivers(),
+    send_slab(nullptr),
+    free_send_slots(),
+    recv_slabs(),
+    send_error_count(0)
+{
+    if (!uring.isReady()) {
+        return;
+    }
+
+    /* registered buffers for sending */
+    if (posix_memalign(reinterpret_cast<void **>(&send_slab), sysconf(_SC_PAGESIZE), SEND_SLOT_COUNT * SEND_SLOT_SIZE)) {
+        send_slab = nullptr;
+        return;
+    }
+    iovec send_iov = { send_slab, SEND_SLOT_COUNT * SEND_SLOT_SIZE };
+    if (!uring.registerBuffers(&send_iov, 1)) {
+        std::cout << "Error : io_uring buffer registration failed, errno = " << errno << std::endl;
+        return;
+    }
+    for (uint32_t i = 0; i < SEND_SLOT_COUNT; i++) {
+        free_send_slots.push_back(SEND_SLOT_COUNT - 1 - i);
+    }
+
+    /* provided buffers for receiving. jumbo buffers are allocated once a socket needs them */
+    if (!allocateReceivePool(RECV_POOL_STANDARD)) {
+        return;
+    }
+
+    // multishot receives need linux 6.0, older kernels fail them with -EINVAL
+    if (!probeMultishotReceive()) {
+        std::cout << "Error : io_uring multishot receive is not supported" << std::endl;
+        return;
+    }
+
+    is_ready = true;
+}
+
+IoUringEngine::~IoUringEngine()
+{
+    if (thread_engine == this) {
+        thread_engine = nullptr;
+    }
+    free(send_slab);
+    for (auto &recv_slab : recv_slabs) {
+        free(recv_slab);
+    }
+}
+
+bool IoUringEngine::addReceiver(int sock_fd, uint32_t max_frame_size, ReceiveHandler handler, ReceiveErrorHandler error_handler)
+{
+    if (!is_ready) {
+        return false;
+    }
+    RecvPool pool = getRecvPool(max_frame_size);
+    if (!allocateReceivePool(pool)) {
+        return false;
+    }
+    receivers.push_back(Receiver{ sock_fd, pool, pool, std::move(handler), std::move(error_handler) });
+    return armReceive(receivers.size() - 1);
+}
+
+void IoUringEngine::setMaxFrameSize(int sock_fd, uint32_t max_frame_size)
+{
+    RecvPool pool = getRecvPool(max_frame_size);
+    if (!allocateReceivePool(pool)) {
+        return;
+    }
+    for (uint32_t i = 0; i < receivers.size(); i++) {
+        Receiver &receiver = receivers[i];
+        if (receiver.sock_fd != sock_fd || receiver.next_pool == pool) {
+            continue;
+        }
+        receiver.next_pool = pool;
+        if (receiver.pool == pool) {
+            // moved back before the cancellation completed, the receive is armed on the new pool anyway
+            continue;
+        }
+
+        // the terminated receive is armed again on `next_pool`
+        io_uring_sqe *sqe = uring.getSqe();
+        if (!sqe) {
+            uring.submit();
+            sqe = uring.getSqe();
+        }
+        if (!sqe) {
+            std::cout << "Error : io_uring receive on socket " << sock_fd << " could not be moved to another buffer pool" << std::endl;
+            continue;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = USER_DATA_RECV | i;
+        sqe->user_data = USER_DATA_CONTROL | CONTROL_CANCEL;
+    }
+}
+
+bool IoUringEngine::armReceive(uint32_t receiver_index)
+{
+    io_uring_sqe *sqe = uring.getSqe();
+    if (!sqe) {
+        uring.submit();
+        sqe = uring.getSqe();
+    }
+    if (!sqe) {
+        return false;
+    }
+
+    Receiver &receiver = receivers[receiver_index];
+    receiver.pool = receiver.next_pool;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = receiver.sock_fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = receiver.pool;
+    sqe->user_data = USER_DATA_RECV | receiver_index;
+    return true;
+}
+
+bool IoUringEngine::allocateReceivePool(RecvPool pool)
+{
+    if (recv_slabs[pool]) {
+        return true;
+    }
+    if (posix_memalign(reinterpret_cast<void **>(&recv_slabs[pool]), sysconf(_SC_PAGESIZE), RECV_BUFFER_COUNT[pool] * getRecvBufferSize(pool))) {
+        recv_slabs[pool] = nullptr;
+        std::cout << "Error : io_uring receive buffers could not be allocated" << std::endl;
+        return false;
+    }
+    return provideReceiveBuffers(pool, 0, RECV_BUFFER_COUNT[pool]);
+}
+
+bool IoUringEngine::provideReceiveBuffers(RecvPool pool, uint16_t first_buffer_id, uint32_t count)
+{
+    io_uring_sqe *sqe = uring.getSqe();
+    if (!sqe) {
+        uring.submit();
+        sqe = uring.getSqe();
+    }
+    if (!sqe) {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = count;
+    sqe->addr = reinterpret_cast<uint64_t>(recv_slabs[pool] + first_buffer_id * getRecvBufferSize(pool));
+    sqe->len = getRecvBufferSize(pool);
+    sqe->off = first_buffer_id;
+    sqe->buf_group = pool;
+    sqe->user_data = USER_DATA_PROVIDE;
+    return true;
+}
+
+bool IoUringEngine::probeMultishotReceive()
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) < 0) {
+        return false;
+    }
+
+    // a readable socket completes the receive at once, with IORING_CQE_F_MORE if it stays armed
+    char probe_data = 0;
+    io_uring_sqe *sqe = uring.getSqe();
+    if (!sqe || write(fds[1], &probe_data, sizeof(probe_data)) != sizeof(probe_data)) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fds[0];
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_POOL_STANDARD;
+    sqe->user_data = USER_DATA_CONTROL | CONTROL_PROBE_RECEIVE;
+
+    bool is_supported = false;
+    bool is_armed = true;
+    bool is_cancel_queued = false;
+    while (is_armed) {
+        if (int rc = uring.submitAndWait(1); rc < 0 && rc != -EINTR) {
+            break;
+        }
+        while (io_uring_cqe *cqe = uring.peekCqe()) {
+            uint64_t user_data = cqe->user_data;
+            int32_t res = cqe->res;
+            uint32_t flags = cqe->flags;
+            uring.cqeSeen();
+
+            // completions of the buffer provision and of the cancellation need no handling
+            if (user_data != (USER_DATA_CONTROL | CONTROL_PROBE_RECEIVE)) {
+                continue;
+            }
+            if (flags & IORING_CQE_F_BUFFER) {
+                provideReceiveBuffers(RECV_POOL_STANDARD, flags >> IORING_CQE_BUFFER_SHIFT, 1);
+            }
+            if (res > 0 && (flags & IORING_CQE_F_MORE)) {
+                is_supported = true;
+            }
+            if (!(flags & IORING_CQE_F_MORE)) {
+                is_armed = false;
+            }
+        }
+
+        // the probe receive must be gone before its socket is closed
+        if (is_armed && !is_cancel_queued) {
+            io_uring_sqe *cancel_sqe = uring.getSqe();
+            if (!cancel_sqe) {
+                break;
+            }
+            cancel_sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            cancel_sqe->addr = USER_DATA_CONTROL | CONTROL_PROBE_RECEIVE;
+            cancel_sqe->user_data = USER_DATA_CONTROL | CONTROL_CANCEL;
+            is_cancel_queued = true;
+        }
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    return is_supported && !is_armed;
+}
+
+int IoUringEngine::queueSend(int sock_fd, const iovec *segments, uint32_t segment_count)
+{
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < segment_count; i++) {
+        size += segments[i].iov_len;
+    }
+    if (free_send_slots.empty() || size > SEND_SLOT_SIZE) {
+        return -1;
+    }
+
+    io_uring_sqe *sqe = uring.getSqe();
+    if (!sqe) {
+        uring.submit();
+        sqe = uring.getSqe();
+    }
+    if (!sqe) {
+        return -1;
+    }
+
+    uint16_t slot = free_send_slots.back();
+    free_send_slots.pop_back();
+
+    char *frame = send_slab + slot * SEND_SLOT_SIZE;
+    for (uint32_t i = 0, offset = 0; i < segment_count; offset += segments[i].iov_len, i++) {
+        memcpy(frame + offset, segments[i].iov_base, segments[i].iov_len);
+    }
+
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = sock_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(frame);
+    sqe->len = size;
+    sqe->buf_index = 0;
+    sqe->user_data = USER_DATA_SEND | slot;
+
+    return size;
+}
+
+void IoUringEngine::processCompletions()
+{
+    while (io_uring_cqe *cqe = uring.peekCqe()) {
+        uint64_t user_data = cqe->user_data;
+        int32_t res = cqe->res;
+        uint32_t flags = cqe->flags;
+        uring.cqeSeen();
+
+        switch (user_data & USER_DATA_TAG_MASK) {
+        case USER_DATA_RECV:
+        {
+            uint32_t receiver_index = user_data & ~USER_DATA_TAG_MASK;
+            RecvPool pool = receivers[receiver_index].pool;
+            if (flags & IORING_CQE_F_BUFFER) {
+                uint16_t buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+                if (res > 0) {
+                    receivers[receiver_index].handler(recv_slabs[pool] + buffer_id * getRecvBufferSize(pool), res);
+                }
+                // handed back to the kernel by the next submission
+                provideReceiveBuffers(pool, buffer_id, 1);
+            }
+            if (flags & IORING_CQE_F_MORE) {
+                break;
+            }
+            // multishot receive terminated : arm it again if it only ran out of provided buffers,
+            // or was cancelled by `setMaxFrameSize` to move to another pool
+            if (res >= 0 || res == -ENOBUFS || res == -ECANCELED) {
+                armReceive(receiver_index);
+            }
+            else {
+                std::cout << "Error : io_uring receive on socket " << receivers[receiver_index].sock_fd
+                          << " failed, errno = " << -res << std::endl;
+                receivers[receiver_index].error_handler();
+            }
+            break;
+        }
+        case USER_DATA_SEND:
+        {
+            free_send_slots.push_back(user_data & ~USER_DATA_TAG_MASK);
+            if (res < 0) {
+                uint64_t error_count = send_error_count.load(std::memory_order_relaxed) + 1;
+                send_error_count.store(error_count, std::memory_order_relaxed);
+                // logged at powers of two, so that a broken peer does not flood the console
+                if (!(error_count & (error_count - 1))) {
+                    std::cout << "Error : io_uring send failed, errno = " << -res << ", " << error_count << " send errors so far" << std::endl;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,312 @@
+/**
+ * @file uring.hpp
+ * @author Jayson Sho Toma
+ * @brief io_uring based UDP frame I/O used by the receiver threads.
+ * @version 0.1
+ * @date 2022-05-07
+ */
+
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "comm.hpp"
+
+/**
+ * @class IoUring
+ * @brief minimal wrapper of an io_uring instance, built directly on top of the io_uring syscalls.
+ *        Only the thread which owns the instance may use it.
+ */
+class IoUring {
+public:
+    /**
+     * @brief Construct a new IoUring object
+     *
+     * @param entries number of submission queue entries
+     */
+    explicit IoUring(uint32_t entries);
+
+    /**
+     * @brief Destroy the IoUring object. The rings are unmapped and the file descriptor is closed.
+     *
+     */
+    ~IoUring();
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    bool isReady() const
+    {
+        return ring_fd >= 0;
+    }
+
+    /**
+     * @brief gets the file descriptor of the ring. it becomes readable when completions are posted.
+     *
+     * @return int
+     */
+    int getFileDescriptor() const
+    {
+        return ring_fd;
+    }
+
+    /**
+     * @brief returns a cleared submission queue entry.
+     *
+     * @return io_uring_sqe*. nullptr if the submission queue is full.
+     */
+    io_uring_sqe *getSqe();
+
+    /**
+     * @brief submits all the prepared entries with a single io_uring_enter call.
+     *
+     * @return int number of submitted entries. negative errno on failure.
+     */
+    int submit();
+
+    /**
+     * @brief submits all the prepared entries and blocks until at least `wait_nr` completions are posted.
+     *
+     * @param wait_nr number of completions to wait for
+     * @return int number of submitted entries. negative errno on failure.
+     */
+    int submitAndWait(uint32_t wait_nr);
+
+    /**
+     * @brief returns the oldest unseen completion.
+     *
+     * @return io_uring_cqe*. nullptr if there are no completions.
+     */
+    io_uring_cqe *peekCqe();
+
+    /**
+     * @brief marks the completion returned by `peekCqe` as consumed.
+     *
+     */
+    void cqeSeen();
+
+    /**
+     * @brief registers fixed buffers which can be used by *_FIXED operations.
+     *
+     * @param iovs buffers
+     * @param n_iovs number of buffers
+     * @return true if registration succeeds
+     * @return false otherwise
+     */
+    bool registerBuffers(const iovec *iovs, uint32_t n_iovs);
+
+private:
+    int ring_fd;
+    uint32_t sq_entries;
+
+    void *sq_ring_ptr;
+    size_t sq_ring_size;
+    void *cq_ring_ptr;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    /* submission queue */
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t sqe_tail; // entries handed out by getSqe(), not yet submitted if ahead of *sq_tail
+
+    /* completion queue */
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    io_uring_cqe *cqes;
+};
+
+/**
+ * @class IoUringEngine
+ * @brief per receiver thread frame I/O engine.
+ *        - node sockets are read by multishot receives into a pool of kernel-selected provided buffers.
+ *          the engine is not ready unless the kernel supports multishot receives.
+ *          sockets receiving jumbo frames use a second pool of jumbo buffers, allocated on first use.
+ *        - frames are sent from a registered buffer slab with WRITE_FIXED on connected transmit sockets.
+ *          send slots hold frames of the default MTU, larger frames are left to the caller.
+ *        - all the prepared sends are submitted by a single io_uring_enter call per event loop round.
+ */
+class IoUringEngine {
+public:
+    /**
+     * @brief callback invoked with a received frame. the buffer is recycled as soon as the callback returns.
+     *
+     */
+    using ReceiveHandler = std::function<void(char *frame, uint32_t frame_size)>;
+
+    /**
+     * @brief callback invoked once the receive on a socket has failed and has been given up.
+     *        the socket must be read by other means from then on.
+     *
+     */
+    using ReceiveErrorHandler = std::function<void()>;
+
+    IoUringEngine();
+    ~IoUringEngine();
+
+    IoUringEngine(const IoUringEngine &) = delete;
+    IoUringEngine &operator=(const IoUringEngine &) = delete;
+
+    bool isReady() const
+    {
+        return is_ready;
+    }
+
+    int getFileDescriptor() const
+    {
+        return uring.getFileDescriptor();
+    }
+
+    /**
+     * @brief arms a multishot receive on `sock_fd`.
+     *
+     * @param sock_fd socket to be read
+     * @param max_frame_size size of the largest frame to be received, up to MAX_PACKET_BUFFER_SIZE
+     * @param handler callback invoked for each received frame
+     * @param error_handler callback invoked if the receive fails with an error other than running out of buffers
+     * @return true if the receive is armed
+     * @return false otherwise
+     */
+    bool addReceiver(int sock_fd, uint32_t max_frame_size, ReceiveHandler handler, ReceiveErrorHandler error_handler);
+
+    /**
+     * @brief changes the size of the largest frame received from `sock_fd`. if the frames need buffers
+     *        of the other pool, the receive is cancelled and armed again on that pool.
+     *
+     * @param sock_fd socket added by `addReceiver`
+     * @param max_frame_size size of the largest frame to be received, up to MAX_PACKET_BUFFER_SIZE
+     */
+    void setMaxFrameSize(int sock_fd, uint32_t max_frame_size);
+
+    /**
+     * @brief prepares a send of the frame gathered from `segments` on the connected socket `sock_fd`.
+     *        the send is issued by the next `submit`.
+     *
+     * @param sock_fd connected socket
+     * @param segments pieces of the frame, copied back to back into a registered send slot
+     * @param segment_count number of segments
+     * @return int size of the queued data. -1 if no send slot is available or the frame exceeds a slot.
+     */
+    int queueSend(int sock_fd, const iovec *segments, uint32_t segment_count);
+
+    /**
+     * @brief submits all the prepared operations.
+     *
+     * @return int number of submitted entries
+     */
+    int submit()
+    {
+        return uring.submit();
+    }
+
+    /**
+     * @brief handles all the posted completions : delivers received frames, recycles buffers,
+     *        re-arms receives terminated by running out of buffers, gives up failed receives, frees send slots
+     *        and counts failed sends.
+     *
+     */
+    void processCompletions();
+
+    /**
+     * @brief returns the number of sends which completed with an error. safe to call from any thread.
+     *
+     * @return uint64_t
+     */
+    uint64_t getSendErrorCount() const
+    {
+        return send_error_count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief binds the engine to the calling thread. frames sent from the thread go through the engine.
+     *
+     */
+    void bindToThisThread()
+    {
+        thread_engine = this;
+    }
+
+    /**
+     * @brief returns the engine bound to the calling thread.
+     *
+     * @return IoUringEngine*. nullptr if no engine is bound to the thread.
+     */
+    static IoUringEngine *getThreadEngine()
+    {
+        return thread_engine;
+    }
+
+private:
+    static constexpr uint32_t RING_ENTRIES = 256;
+    static constexpr uint32_t SEND_SLOT_COUNT = 128;
+    static constexpr uint32_t SEND_SLOT_SIZE = STANDARD_PACKET_BUFFER_SIZE;
+
+    /**
+     * @brief pool of provided receive buffers, registered as a buffer group
+     *
+     */
+    enum RecvPool : uint16_t {
+        RECV_POOL_STANDARD, /* STANDARD_PACKET_BUFFER_SIZE bytes per buffer */
+        RECV_POOL_JUMBO,    /* MAX_PACKET_BUFFER_SIZE bytes per buffer */
+        RECV_POOL_COUNT,
+    };
+
+    static constexpr uint32_t RECV_BUFFER_COUNT[RECV_POOL_COUNT] = { 256, 32 };
+
+    static RecvPool getRecvPool(uint32_t max_frame_size)
+    {
+        return max_frame_size <= STANDARD_PACKET_BUFFER_SIZE ? RECV_POOL_STANDARD : RECV_POOL_JUMBO;
+    }
+
+    static uint32_t getRecvBufferSize(RecvPool pool)
+    {
+        return pool == RECV_POOL_STANDARD ? STANDARD_PACKET_BUFFER_SIZE : MAX_PACKET_BUFFER_SIZE;
+    }
+
+    /* tags stored in the upper bits of user_data */
+    static constexpr uint64_t USER_DATA_CONTROL = 0ull << 62; /* probe and cancel requests */
+    static constexpr uint64_t USER_DATA_RECV = 1ull << 62;
+    static constexpr uint64_t USER_DATA_SEND = 2ull << 62;
+    static constexpr uint64_t USER_DATA_PROVIDE = 3ull << 62;
+    static constexpr uint64_t USER_DATA_TAG_MASK = 3ull << 62;
+
+    /* control requests, under USER_DATA_CONTROL */
+    static constexpr uint64_t CONTROL_PROBE_RECEIVE = 0;
+    static constexpr uint64_t CONTROL_CANCEL = 1;
+
+    bool armReceive(uint32_t receiver_index);
+    bool provideReceiveBuffers(RecvPool pool, uint16_t first_buffer_id, uint32_t count);
+    bool allocateReceivePool(RecvPool pool);
+    bool probeMultishotReceive();
+
+    struct Receiver {
+        int sock_fd;
+        RecvPool pool;       /* pool of the armed receive */
+        RecvPool next_pool;  /* pool of the next receive, differs from `pool` while the receive is being moved */
+        ReceiveHandler handler;
+        ReceiveErrorHandler error_handler;
+    };
+
+    IoUring uring;
+    bool is_ready;
+
+    std::vector<Receiver> receivers;
+
+    char *send_slab;
+    std::vector<uint16_t> free_send_slots;
+
+    char *recv_slabs[RECV_POOL_COUNT];
+
+    std::atomic<uint64_t> send_error_count; /* written by the owning thread only */
+
+    inline static thread_local IoUringEngine *thread_engine = nullptr;
+};